@@ -0,0 +1,206 @@
+#ifndef _FILEWATCHER_H_
+#define _FILEWATCHER_H_
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#else
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <sys/stat.h>
+#endif
+using namespace std;
+
+namespace util
+{
+
+/*
+ * This class watches a set of files for changes on a background thread.
+ *
+ * The owner asks hasChanged() whenever it is convenient (e.g. once per frame).
+ * That call only reads an atomic flag, so it costs nothing while no file
+ * changes; all the waiting happens on the watcher's own thread.
+ *
+ * On Linux the parent directories are watched with inotify, which also
+ * catches editors that save by writing a new file and renaming it over the
+ * old one. Elsewhere the modification times are polled a few times a second.
+ */
+class FileWatcher
+{
+public:
+    /*
+     * Start watching the given files
+     * \param files the paths of the files to watch
+     */
+    FileWatcher(const vector<string>& files)
+    {
+        changed = false;
+        for (unsigned int i=0;i<files.size();i++)
+        {
+            size_t slash = files[i].find_last_of("/\\");
+            if (slash==string::npos)
+            {
+                dirs.push_back(".");
+                names.push_back(files[i]);
+            }
+            else
+            {
+                dirs.push_back(files[i].substr(0,slash));
+                names.push_back(files[i].substr(slash+1));
+            }
+        }
+        paths = files;
+        start();
+    }
+
+    ~FileWatcher()
+    {
+        stop();
+    }
+
+    /*
+     * Return true if any watched file changed since the last call
+     */
+    bool hasChanged()
+    {
+        if (!changed.load(memory_order_relaxed))
+            return false;
+        return changed.exchange(false);
+    }
+
+private:
+    FileWatcher(const FileWatcher&);
+    FileWatcher& operator=(const FileWatcher&);
+
+#ifdef __linux__
+    void start()
+    {
+        notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if ((notifyFd<0) || (pipe(stopPipe)!=0))
+        {
+            stopPipe[0] = stopPipe[1] = -1;
+            return;
+        }
+        for (unsigned int i=0;i<dirs.size();i++)
+            watches.push_back(inotify_add_watch(notifyFd,dirs[i].c_str(),IN_CLOSE_WRITE | IN_MOVED_TO));
+        watcher = thread(&FileWatcher::run,this);
+    }
+
+    void stop()
+    {
+        if (watcher.joinable())
+        {
+            char c = 0;
+            if (write(stopPipe[1],&c,1)<0) {}
+            watcher.join();
+        }
+        if (stopPipe[0]>=0)
+        {
+            close(stopPipe[0]);
+            close(stopPipe[1]);
+        }
+        if (notifyFd>=0)
+            close(notifyFd);
+    }
+
+    void run()
+    {
+        char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        while (true)
+        {
+            struct pollfd fds[2];
+            fds[0].fd = notifyFd;
+            fds[0].events = POLLIN;
+            fds[1].fd = stopPipe[0];
+            fds[1].events = POLLIN;
+            if (poll(fds,2,-1)<0)
+                continue;
+            if (fds[1].revents!=0)
+                return;
+
+            ssize_t length = read(notifyFd,buffer,sizeof(buffer));
+            for (ssize_t offset=0;offset<length;)
+            {
+                const struct inotify_event *event = (const struct inotify_event *)(buffer+offset);
+                if (event->len>0)
+                {
+                    for (unsigned int i=0;i<names.size();i++)
+                    {
+                        if ((watches[i]==event->wd) && (names[i]==event->name))
+                            changed = true;
+                    }
+                }
+                offset += sizeof(struct inotify_event)+event->len;
+            }
+        }
+    }
+
+    int notifyFd;
+    int stopPipe[2];
+    vector<int> watches; //the inotify watch of the directory of each file
+#else
+    void start()
+    {
+        stopping = false;
+        for (unsigned int i=0;i<paths.size();i++)
+            times.push_back(getModificationTime(paths[i]));
+        watcher = thread(&FileWatcher::run,this);
+    }
+
+    void stop()
+    {
+        {
+            lock_guard<mutex> lock(stopMutex);
+            stopping = true;
+        }
+        stopCondition.notify_all();
+        if (watcher.joinable())
+            watcher.join();
+    }
+
+    void run()
+    {
+        unique_lock<mutex> lock(stopMutex);
+        while (!stopCondition.wait_for(lock,chrono::milliseconds(250),[this]{return stopping;}))
+        {
+            for (unsigned int i=0;i<paths.size();i++)
+            {
+                time_t t = getModificationTime(paths[i]);
+                if (t!=times[i])
+                {
+                    times[i] = t;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    static time_t getModificationTime(const string& path)
+    {
+        struct stat info;
+        if (stat(path.c_str(),&info)!=0)
+            return 0;
+        return info.st_mtime;
+    }
+
+    bool stopping;
+    mutex stopMutex;
+    condition_variable stopCondition;
+    vector<time_t> times; //last seen modification time of each file
+#endif
+
+    vector<string> paths; //the watched files
+    vector<string> dirs; //the directory of each watched file
+    vector<string> names; //the name of each watched file within its directory
+    atomic<bool> changed;
+    thread watcher;
+};
+}
+
+#endif
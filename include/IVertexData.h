@@ -30,6 +30,19 @@ public:
      */
     virtual vector<float> getData(string attribName) =0;
 
+    /*
+     * Copies the data for the supplied attribute name into the given array,
+     * reusing its storage. Unlike getData() this need not allocate memory
+     * for every call, so it is preferred in loops over many vertices.
+     * Implementations should override the default, which calls getData()
+     * \param attribName the (unique) name of the attribute
+     * \param data the array to fill with the attribute data
+     */
+    virtual void copyData(string attribName,vector<float>& data)
+    {
+        data = getData(attribName);
+    }
+
     /*
      * set the data for the given attribute. If attribute is not already present,
      * it will be added now. If data is already present for the attribute,
@@ -15,12 +15,13 @@ namespace util
 	 * A helper class to export a PolygonMesh object to file using the OBJ file format
 	 * This exporter only writes the position, normal and texture coordinate data. It
 	 * ignores any other attributes
+	 * \throws runtime_error if normal or texture coordinate data is malformed
 	 */
 	template <class K>
 	class ObjExporter
 	{
 		public:
-			static bool exportFile(const PolygonMesh<K>& mesh,ofstream& out) throw (runtime_error)
+			static bool exportFile(const PolygonMesh<K>& mesh,ofstream& out)
 			{
 				int i,j;
 
@@ -48,11 +48,19 @@ namespace util
                          const map<string,string>& shaderVarsToAttributeNames,
                          const PolygonMesh<K>& mesh) ;
     inline void draw() const;
+    inline void drawRange(unsigned int first,unsigned int count) const;
+    inline void drawInstanced(unsigned int first,unsigned int count,unsigned int instances) const;
+    inline void updateVertexData(unsigned int offset,unsigned int size,const void *data) const;
     inline void setName(string name);
     inline string getName() const;
     inline glm::vec4 getMinimumBounds() const;
     inline glm::vec4 getMaximumBounds() const;
     inline void cleanup();
+    template <class K>
+    static vector<float> packVertexData(vector<K>& vertexDataList,
+                                        const map<string,string>& shaderVarsToAttributeNames,
+                                        map<string,int>& offsets,
+                                        int& sizeOfOneVertex);
   private:
     inline void initVertexObjects();
 
@@ -80,6 +88,51 @@ namespace util
 
 
 
+  /*
+ * Interleave the attributes of all vertices into one array of floats, in
+ * the order of the shader variable -> attribute map, ready to be copied
+ * into a vertex buffer
+ * \param vertexDataList the vertices of the mesh
+ * \param shaderVarsToAttributeNames a mapping of
+ *        shader variable -> vertex attributes in the underlying mesh
+ * \param offsets filled with the offset (in floats) of each attribute
+ *        within one vertex
+ * \param sizeOfOneVertex set to the number of floats in one vertex
+ * \return the interleaved vertex data
+ */
+  template<class K>
+  vector<float> ObjectInstance::packVertexData(vector<K>& vertexDataList,
+                                               const map<string,string>& shaderVarsToAttributeNames,
+                                               map<string,int>& offsets,
+                                               int& sizeOfOneVertex)
+  {
+    unsigned int i,j;
+
+    sizeOfOneVertex=0;
+    for (map<string,string>::const_iterator it=shaderVarsToAttributeNames.cbegin();it!=shaderVarsToAttributeNames.cend();it++)
+      {
+        offsets[it->second] = sizeOfOneVertex;
+        sizeOfOneVertex += vertexDataList[0].getData(it->second).size();
+      }
+
+    vector<float> vertexDataAsFloats;
+    vector<float> data;
+
+    vertexDataAsFloats.reserve(vertexDataList.size()*sizeOfOneVertex);
+    for (i=0;i<vertexDataList.size();i++)
+      {
+        for (map<string,string>::const_iterator e = shaderVarsToAttributeNames.cbegin();e!=shaderVarsToAttributeNames.cend();e++)
+          {
+            vertexDataList[i].copyData(e->second,data);
+            for (j=0;j<data.size();j++)
+              {
+                vertexDataAsFloats.push_back(data[j]);
+              }
+          }
+      }
+    return vertexDataAsFloats;
+  }
+
   /*
  * A helper method that sets this object up for rendering
  * \param program the shader program to be used to render this object
@@ -95,8 +148,6 @@ namespace util
                                        const map<string,string>& shaderVarsToAttributeNames,
                                        const PolygonMesh<K>& mesh)
   {
-    unsigned int i,j;
-
     initVertexObjects();
 
 
@@ -111,12 +162,10 @@ namespace util
 
     int sizeOfOneVertex=0;
     map<string,int> offsets;
-
-    for (map<string,string>::const_iterator it=shaderVarsToAttributeNames.cbegin();it!=shaderVarsToAttributeNames.cend();it++)
-      {
-        offsets[it->second] = sizeOfOneVertex;
-        sizeOfOneVertex += vertexDataList[0].getData(it->second).size();
-      }
+    vector<float> vertexDataAsFloats = packVertexData(vertexDataList,
+                                                      shaderVarsToAttributeNames,
+                                                      offsets,
+                                                      sizeOfOneVertex);
 
     int stride;
 
@@ -126,23 +175,6 @@ namespace util
       stride = 0;
 
 
-    vector<float> vertexDataAsFloats;
-    vector<float> data;
-
-    for (i=0;i<vertexDataList.size();i++)
-      {
-        for (map<string,string>::const_iterator e = shaderVarsToAttributeNames.cbegin();e!=shaderVarsToAttributeNames.cend();e++)
-          {
-            data.clear();
-            data = vertexDataList[i].getData(e->second);
-            for (j=0;j<data.size();j++)
-              {
-                vertexDataAsFloats.push_back(data[j]);
-              }
-          }
-      }
-
-
 
 
 
@@ -234,8 +266,6 @@ namespace util
                                        const map<string,string>& shaderVarsToAttributeNames,
                                        const PolygonMesh<K>& mesh)
   {
-    unsigned int i,j;
-
     initVertexObjects();
 
     primitiveType = mesh.getPrimitiveType();
@@ -249,12 +279,10 @@ namespace util
 
     int sizeOfOneVertex=0;
     map<string,int> offsets;
-
-    for (map<string,string>::const_iterator it=shaderVarsToAttributeNames.cbegin();it!=shaderVarsToAttributeNames.cend();it++)
-      {
-        offsets[it->second] = sizeOfOneVertex;
-        sizeOfOneVertex += vertexDataList[0].getData(it->second).size();
-      }
+    vector<float> vertexDataAsFloats = packVertexData(vertexDataList,
+                                                      shaderVarsToAttributeNames,
+                                                      offsets,
+                                                      sizeOfOneVertex);
 
     int stride;
 
@@ -264,23 +292,6 @@ namespace util
       stride = 0;
 
 
-    vector<float> vertexDataAsFloats;
-    vector<float> data;
-
-    for (i=0;i<vertexDataList.size();i++)
-      {
-        for (map<string,string>::const_iterator e = shaderVarsToAttributeNames.cbegin();e!=shaderVarsToAttributeNames.cend();e++)
-          {
-            data.clear();
-            data = vertexDataList[i].getData(e->second);
-            for (j=0;j<data.size();j++)
-              {
-                vertexDataAsFloats.push_back(data[j]);
-              }
-          }
-      }
-
-
 
 
 
@@ -386,6 +397,46 @@ namespace util
     glBindVertexArray(0);
   }
 
+  /*
+ * Draw only part of this ObjectInstance: count indices starting at index
+ * first, e.g. one of several line strips that share its buffers.
+ */
+
+  void ObjectInstance::drawRange(unsigned int first,unsigned int count) const
+  {
+    glBindVertexArray(vao);
+    glDrawElements(primitiveType,count, GL_UNSIGNED_INT,
+                   (GLvoid *)(first * sizeof(GLuint)));
+    glBindVertexArray(0);
+  }
+
+  /*
+ * Draw count indices starting at index first, instances times over. The
+ * shader tells the copies apart by gl_InstanceID.
+ */
+
+  void ObjectInstance::drawInstanced(unsigned int first,unsigned int count,unsigned int instances) const
+  {
+    glBindVertexArray(vao);
+    glDrawElementsInstanced(primitiveType,count, GL_UNSIGNED_INT,
+                            (GLvoid *)(first * sizeof(GLuint)),instances);
+    glBindVertexArray(0);
+  }
+
+
+
+  /*
+ * Overwrite size bytes of the vertex data from byte offset on, e.g. to
+ * stream new vertices into a buffer that stays the same size.
+ */
+
+  void ObjectInstance::updateVertexData(unsigned int offset,unsigned int size,const void *data) const
+  {
+    glBindBuffer(GL_ARRAY_BUFFER, vbo[0]);
+    glBufferSubData(GL_ARRAY_BUFFER,offset,size,data);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+
 
 
   /*
@@ -71,10 +71,27 @@ public:
      * Compute the bounding box of this polygon mesh, if there is position data
      */
     void computeBoundingBox();
+    /*
+     * Compute the bounding box of the vertices used by count indices of this
+     * polygon mesh starting at index first, e.g. of one stretch of a long
+     * line strip. The box of the whole mesh is left as it is.
+     */
+    void computeBoundingBox(unsigned int first,
+                            unsigned int count,
+                            glm::vec4& minimum,
+                            glm::vec4& maximum);
 
 
 
 protected:
+    //position of vertex i, copied through data which is reused between calls
+    glm::vec4 getPosition(unsigned int i,vector<float>& data);
+    //grows minimum and maximum to include p, or starts them at p if first
+    static void growBounds(const glm::vec4& p,
+                           bool first,
+                           glm::vec4& minimum,
+                           glm::vec4& maximum);
+
     vector<VertexType> vertexData;
     vector<unsigned int> primitives;
     int primitiveType;
@@ -172,7 +189,7 @@ void PolygonMesh<VertexType>::setPrimitives(const vector<unsigned int>& t)
 template<class VertexType>
 void PolygonMesh<VertexType>::computeBoundingBox()
 {
-    unsigned int i,j;
+    unsigned int i;
 
     if (vertexData.size()<=0)
         return;
@@ -182,57 +199,101 @@ void PolygonMesh<VertexType>::computeBoundingBox()
         return;
     }
 
-    vector<glm::vec4> positions;
+    //one array reused for every vertex, instead of a copy of all positions
+    vector<float> data;
 
     for (i=0;i<vertexData.size();i++)
     {
-        vector<float> data = vertexData[i].getData("position");
-        glm::vec4 pos = glm::vec4(0,0,0,1);
-        switch (data.size()) {
-        case 4: pos.w = data[3];
-        case 3: pos.z = data[2];
-        case 2: pos.y = data[1];
-        case 1: pos.x = data[0];
-        }
-        positions.push_back(pos);
+        growBounds(getPosition(i,data),i==0,minBounds,maxBounds);
     }
+}
+
+template<class VertexType>
+void PolygonMesh<VertexType>::computeBoundingBox(unsigned int first,
+                                                 unsigned int count,
+                                                 glm::vec4& minimum,
+                                                 glm::vec4& maximum)
+{
+    unsigned int i,end;
 
-    minBounds = glm::vec4(positions[0]);
-    maxBounds = glm::vec4(positions[0]);
+    minimum = glm::vec4(0,0,0,1);
+    maximum = glm::vec4(0,0,0,1);
 
-    for (j=0;j<positions.size();j++)
+    if (vertexData.size()<=0)
+        return;
+
+    if (!vertexData[0].hasData("position"))
     {
-        glm::vec4 p = positions[j];
+        return;
+    }
 
-        if (p.x<minBounds.x)
-        {
-            minBounds.x = p.x;
-        }
+    vector<float> data;
 
-        if (p.x>maxBounds.x)
-        {
-            maxBounds.x = p.x;
-        }
+    end = first+count;
+    if (end>primitives.size())
+    {
+        end = primitives.size();
+    }
+    for (i=first;i<end;i++)
+    {
+        growBounds(getPosition(primitives[i],data),i==first,minimum,maximum);
+    }
+}
 
-        if (p.y<minBounds.y)
-        {
-            minBounds.y = p.y;
-        }
+template<class VertexType>
+glm::vec4 PolygonMesh<VertexType>::getPosition(unsigned int i,vector<float>& data)
+{
+    vertexData[i].copyData("position",data);
+    glm::vec4 p = glm::vec4(0,0,0,1);
+    switch (data.size()) {
+    case 4: p.w = data[3];
+    case 3: p.z = data[2];
+    case 2: p.y = data[1];
+    case 1: p.x = data[0];
+    }
+    return p;
+}
 
-        if (p.y>maxBounds.y)
-        {
-            maxBounds.y = p.y;
-        }
+template<class VertexType>
+void PolygonMesh<VertexType>::growBounds(const glm::vec4& p,
+                                         bool first,
+                                         glm::vec4& minimum,
+                                         glm::vec4& maximum)
+{
+    if (first)
+    {
+        minimum = p;
+        maximum = p;
+    }
 
-        if (p.z<minBounds.z)
-        {
-            minBounds.z = p.z;
-        }
+    if (p.x<minimum.x)
+    {
+        minimum.x = p.x;
+    }
 
-        if (p.z>maxBounds.z)
-        {
-            maxBounds.z = p.z;
-        }
+    if (p.x>maximum.x)
+    {
+        maximum.x = p.x;
+    }
+
+    if (p.y<minimum.y)
+    {
+        minimum.y = p.y;
+    }
+
+    if (p.y>maximum.y)
+    {
+        maximum.y = p.y;
+    }
+
+    if (p.z<minimum.z)
+    {
+        minimum.z = p.z;
+    }
+
+    if (p.z>maximum.z)
+    {
+        maximum.z = p.z;
     }
 }
 
@@ -1,13 +1,36 @@
 #ifndef _SHADERPROGRAM_H_
 #define _SHADERPROGRAM_H_
 
-#include <GLFW/glfw3.h>
+#include <glad/glad.h>
 #include "ShaderLocationsVault.h"
+#include "FileWatcher.h"
 #include <fstream>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <vector>
+#include <cstdio>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
 using namespace std;
 
+//program binaries are core in OpenGL 4.1, newer than the bundled glad loader,
+//so the entry points are looked up at runtime
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
 namespace util
 {	
 
@@ -30,15 +53,17 @@ class ShaderProgram
        // is it a vertex shader, a fragment shader, a geometry shader,
        // a tesselation shader or none of the above?
         int type;
-        string  filename; //the file that stores this shader
+        string  filename; //the file that stores this shader, empty if embedded
+        string  source; //the source code of this shader
         int shader; //the ID for this shader after it has been compiled
 
 
     public:
-        ShaderInfo(int type,string filename,int shader)
+        ShaderInfo(int type,string filename,string source,int shader)
         {
             this->type = type;
             this->filename = filename;
+            this->source = source;
             this->shader = shader;
         }
 
@@ -46,6 +71,7 @@ class ShaderProgram
         {
             this->type = 0;
             this->filename = "";
+            this->source = "";
             this->shader = 0;
         }
 
@@ -57,6 +83,11 @@ public:
     {
         program = -1;
         enabled = false;
+        fromCache = false;
+        getProgramBinary = NULL;
+        programBinary = NULL;
+        programParameteri = NULL;
+        loader = NULL;
     }
 
     ~ShaderProgram()
@@ -89,13 +120,131 @@ public:
     {
 
         releaseShaders();
+        watcher.reset();
+
+        shaders[0] = ShaderInfo(GL_VERTEX_SHADER,vertShaderFile,
+                                readShaderFile(vertShaderFile),-1);
+        shaders[1] = ShaderInfo(GL_FRAGMENT_SHADER,fragShaderFile,
+                                readShaderFile(fragShaderFile),-1);
+
+        program = createShaders();
+    }
+
+    /*
+     * Create a new shader program from source code that is already in
+     * memory, for example shaders compiled into the executable. No file
+     * is touched, so this works regardless of the working directory.
+     * \param vertShaderSource the source code for the vertex shader
+     * \param fragShaderSource the source code for the fragment shader
+     * \throws runtime_error if any error is encountered
+     */
+    void createProgramFromSource(const string& vertShaderSource,
+                                 const string& fragShaderSource)
+    {
+
+        releaseShaders();
+        watcher.reset();
 
-        shaders[0] = ShaderInfo(GL_VERTEX_SHADER,vertShaderFile,-1);
-        shaders[1] = ShaderInfo(GL_FRAGMENT_SHADER,fragShaderFile,-1);
+        shaders[0] = ShaderInfo(GL_VERTEX_SHADER,"",vertShaderSource,-1);
+        shaders[1] = ShaderInfo(GL_FRAGMENT_SHADER,"",fragShaderSource,-1);
 
         program = createShaders();
     }
 
+    /*
+     * Start watching the source files of this program for changes, so that
+     * reloadIfChanged() can pick up edits while the program is running.
+     * Does nothing for a program created from source code in memory.
+     */
+    void watchSourceFiles()
+    {
+        vector<string> files;
+        for (int i=0;i<2;i++)
+        {
+            if (!shaders[i].filename.empty())
+                files.push_back(shaders[i].filename);
+        }
+        if (!files.empty())
+            watcher.reset(new FileWatcher(files));
+    }
+
+    /*
+     * If a watched source file changed since the last call, compile and
+     * link the program again from the files. Cheap enough to call every
+     * frame: when nothing changed it only checks a flag.
+     *
+     * The new program replaces the old one only if it compiles and links;
+     * afterwards the shader variables must be fetched again with
+     * getAllShaderVariables().
+     * \return true if the program was replaced
+     * \throws runtime_error with the compiler log if the new sources do not
+     *         compile or link. The old program stays in use.
+     */
+    bool reloadIfChanged()
+    {
+        if (!watcher || !watcher->hasChanged())
+            return false;
+
+        ShaderInfo old[2] = {shaders[0],shaders[1]};
+        int oldProgram = program;
+        bool oldFromCache = fromCache;
+        bool wasEnabled = enabled;
+
+        try
+        {
+            for (int i=0;i<2;i++)
+            {
+                shaders[i].shader = 0;
+                shaders[i].source = readShaderFile(shaders[i].filename);
+            }
+            program = createShaders();
+        }
+        catch (runtime_error& e)
+        {
+            //createShaders() cleaned up after itself, go back to the old program
+            for (int i=0;i<2;i++)
+                shaders[i] = old[i];
+            program = oldProgram;
+            fromCache = oldFromCache;
+            throw;
+        }
+
+        for (int i=0;i<2;i++)
+        {
+            if (old[i].shader!=0)
+                glDeleteShader(old[i].shader);
+        }
+        glDeleteProgram(oldProgram);
+        if (wasEnabled)
+            enable();
+        return true;
+    }
+
+    /*
+     * Keep linked programs in the given directory, so that later runs with
+     * the same shader sources and the same driver can skip compiling and
+     * linking. Must be called before the program is created. An empty
+     * string (the default) disables the cache. Any problem with the cache
+     * silently falls back to compiling from source.
+     * \param dir the directory to store program binaries in
+     * \param loader looks up the GL 4.1 program binary entry points, e.g.
+     * glfwGetProcAddress (cast to GLADloadproc)
+     */
+    void setBinaryCacheDirectory(const string& dir,GLADloadproc loader)
+    {
+        cacheDirectory = dir;
+        this->loader = loader;
+    }
+
+    /*
+     * Return whether the current program was loaded from the binary cache
+     * instead of being compiled from source
+     */
+    bool isFromBinaryCache() const
+    {
+        return fromCache;
+    }
+
     /*
      * Releases the resources (i.e. memory locations) for this shader. This must be called
      * only after the shader program is used, and will not be used again.
@@ -207,39 +356,49 @@ private:
     }
 
 
-    int createShaders()
+    string readShaderFile(const string& filename)
     {
-        ifstream file;
-        GLint linked,compiled;
-
-        program = glCreateProgram();
-
+        ifstream file(filename.c_str());
 
-        for (int i=0;i<2;i++)
+        if (!file.is_open())
         {
-            file.open(shaders[i].filename.c_str());
-
-
-            if (!file.is_open())
-            {
-                stringstream str;
-                str << "Shader " << shaders[i].filename << "not found or could not be opened!" << endl;
-                throw runtime_error(str.str());
-            }
+            stringstream str;
+            str << "Shader " << filename << " not found or could not be opened!" << endl;
+            throw runtime_error(str.str());
+        }
 
-            string source,line;
+        //read the whole file in one go instead of line by line
+        stringstream source;
+        source << file.rdbuf();
+        return source.str();
+    }
 
+    int createShaders()
+    {
+        GLint linked,compiled;
 
-            getline(file,line);
-            while (!file.eof())
+        fromCache = false;
+        string cacheFile;
+        string identity;
+        if (!cacheDirectory.empty() && getProgramBinaryFunctions())
+        {
+            identity = getBinaryIdentity();
+            cacheFile = getBinaryCacheFile(identity);
+            if (loadProgramBinary(cacheFile,identity))
             {
-                source = source + "\n" + line;
-                getline(file,line);
+                fromCache = true;
+                return program;
             }
-            file.close();
+        }
 
+        program = glCreateProgram();
+        if (!cacheFile.empty())
+            programParameteri(program,GL_PROGRAM_BINARY_RETRIEVABLE_HINT,GL_TRUE);
 
-            const char *codev = source.c_str();
+
+        for (int i=0;i<2;i++)
+        {
+            const char *codev = shaders[i].source.c_str();
 
 
             shaders[i].shader = glCreateShader(shaders[i].type);
@@ -266,9 +425,149 @@ private:
             throw runtime_error(error_message);
         }
 
+        if (!cacheFile.empty())
+            saveProgramBinary(cacheFile,identity);
+
         return program;
     }
 
+    typedef void (APIENTRY *GetProgramBinaryFunc)(GLuint,GLsizei,GLsizei *,GLenum *,void *);
+    typedef void (APIENTRY *ProgramBinaryFunc)(GLuint,GLenum,const void *,GLsizei);
+    typedef void (APIENTRY *ProgramParameteriFunc)(GLuint,GLenum,GLint);
+
+    /*
+     * Look up the program binary entry points, returns false if the driver
+     * does not support program binaries in any format
+     */
+    bool getProgramBinaryFunctions()
+    {
+        if (loader==NULL)
+            return false;
+        getProgramBinary = (GetProgramBinaryFunc)loader("glGetProgramBinary");
+        programBinary = (ProgramBinaryFunc)loader("glProgramBinary");
+        programParameteri = (ProgramParameteriFunc)loader("glProgramParameteri");
+        if ((getProgramBinary==NULL) || (programBinary==NULL) || (programParameteri==NULL))
+            return false;
+
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS,&formats);
+        return formats>0;
+    }
+
+    /*
+     * Everything a stored binary depends on: both shader sources and the
+     * driver that produced it
+     */
+    string getBinaryIdentity()
+    {
+        stringstream str;
+        str << (const char *)glGetString(GL_VENDOR) << "\n"
+            << (const char *)glGetString(GL_RENDERER) << "\n"
+            << (const char *)glGetString(GL_VERSION) << "\n";
+        for (int i=0;i<2;i++)
+            str << shaders[i].source.size() << "\n" << shaders[i].source;
+        return str.str();
+    }
+
+    /*
+     * The cache file is named after a 64-bit FNV-1a hash of the identity
+     */
+    string getBinaryCacheFile(const string& identity)
+    {
+        unsigned long long hash = 14695981039346656037ULL;
+        for (unsigned int i=0;i<identity.size();i++)
+        {
+            hash ^= (unsigned char)identity[i];
+            hash *= 1099511628211ULL;
+        }
+        char name[32];
+        snprintf(name,sizeof(name),"%016llx.bin",hash);
+        return cacheDirectory + "/" + name;
+    }
+
+    /*
+     * Create the program from a stored binary. The file holds the length of
+     * the identity, the identity itself (compared in full, so that a hash
+     * collision cannot load the wrong program), the binary format and the
+     * binary. Returns false, leaving no program behind, on any mismatch.
+     */
+    bool loadProgramBinary(const string& cacheFile,const string& identity)
+    {
+        ifstream file(cacheFile.c_str(),ios::binary);
+        if (!file.is_open())
+            return false;
+
+        unsigned int identityLength = 0;
+        GLenum format = 0;
+        file.read((char *)&identityLength,sizeof(identityLength));
+        if (!file || (identityLength!=identity.size()))
+            return false;
+        string storedIdentity(identityLength,'\0');
+        file.read(&storedIdentity[0],identityLength);
+        file.read((char *)&format,sizeof(format));
+        if (!file || (storedIdentity!=identity))
+            return false;
+        vector<char> binary((istreambuf_iterator<char>(file)),istreambuf_iterator<char>());
+        if (binary.empty())
+            return false;
+
+        program = glCreateProgram();
+        programBinary(program,format,&binary[0],binary.size());
+
+        GLint linked = 0;
+        glGetProgramiv(program,GL_LINK_STATUS,&linked);
+        if (!linked)
+        {
+            //e.g. the driver was updated without changing its version string
+            glDeleteProgram(program);
+            program = 0;
+            return false;
+        }
+        return true;
+    }
+
+    /*
+     * Store the linked program. The file is written under a temporary name
+     * and renamed into place, so that concurrent runs never read a partial file.
+     */
+    void saveProgramBinary(const string& cacheFile,const string& identity)
+    {
+        GLint length = 0;
+        glGetProgramiv(program,GL_PROGRAM_BINARY_LENGTH,&length);
+        if (length<=0)
+            return;
+
+        vector<char> binary(length);
+        GLenum format = 0;
+        GLsizei written = 0;
+        getProgramBinary(program,length,&written,&format,&binary[0]);
+        if (written<=0)
+            return;
+
+#ifdef _WIN32
+        _mkdir(cacheDirectory.c_str());
+        stringstream tempFile;
+        tempFile << cacheFile << "." << _getpid() << ".tmp";
+#else
+        mkdir(cacheDirectory.c_str(),0755);
+        stringstream tempFile;
+        tempFile << cacheFile << "." << getpid() << ".tmp";
+#endif
+
+        ofstream file(tempFile.str().c_str(),ios::binary);
+        if (!file.is_open())
+            return;
+        unsigned int identityLength = identity.size();
+        file.write((const char *)&identityLength,sizeof(identityLength));
+        file.write(identity.data(),identityLength);
+        file.write((const char *)&format,sizeof(format));
+        file.write(&binary[0],written);
+        file.close();
+
+        if (!file || (rename(tempFile.str().c_str(),cacheFile.c_str())!=0))
+            remove(tempFile.str().c_str());
+    }
+
     string printShaderInfoLog(GLuint shader)
     {
         int infologLen = 0;
@@ -298,6 +597,13 @@ private:
     ShaderInfo shaders[2];
     bool enabled;
     GLenum a;
+    string cacheDirectory; //where program binaries are kept, empty if not cached
+    bool fromCache; //whether the current program came from the binary cache
+    GetProgramBinaryFunc getProgramBinary;
+    ProgramBinaryFunc programBinary;
+    ProgramParameteriFunc programParameteri;
+    GLADloadproc loader; //looks up the entry points above, given with the cache directory
+    unique_ptr<FileWatcher> watcher; //watches the source files, if asked to
 
 
 
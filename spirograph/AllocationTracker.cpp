@@ -0,0 +1,125 @@
+#include "AllocationTracker.h"
+
+#ifdef SPIROGRAPH_TRACK_ALLOCATIONS
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <cstdlib>
+#include <cstring>
+#include "spdlog/spdlog.h"
+
+// Implementation of heap allocation tracking of Program.
+
+// counters of one phase, updated from operator new so they must not allocate
+struct PhaseCounters {
+    const char *name;
+    std::atomic<uint64_t> entries; // times the phase was entered
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> bytes;
+};
+
+static PhaseCounters phases[AllocationTracker::MAX_PHASES];
+static std::atomic<int> phaseCount(0);
+static std::atomic<uint64_t> total(0); // all allocations, in or outside of phases
+static std::mutex registerMutex; // guards registration of new phases
+
+// phase of the calling thread, -1 outside of any phase
+static thread_local int currentPhase = -1;
+
+// id of the named phase, registered on first use
+int AllocationTracker::phaseId(const char *name) {
+    std::lock_guard<std::mutex> lock(registerMutex);
+    int count = phaseCount.load();
+    for (int i = 0; i < count; i++) {
+        if (strcmp(phases[i].name, name) == 0) {
+            return i;
+        }
+    }
+    if (count == MAX_PHASES) {
+        return -1;
+    }
+    phases[count].name = name;
+    phaseCount.store(count + 1);
+    return count;
+}
+
+// allocations made so far in a phase
+uint64_t AllocationTracker::allocations(int id) {
+    return id >= 0 ? phases[id].allocations.load(std::memory_order_relaxed) : 0;
+}
+
+// allocations made so far, in or outside of phases
+uint64_t AllocationTracker::totalAllocations() {
+    return total.load(std::memory_order_relaxed);
+}
+
+// makes id the current phase, returns the previous one
+int AllocationTracker::enter(int id) {
+    int previous = currentPhase;
+    if (id >= 0) {
+        phases[id].entries.fetch_add(1, std::memory_order_relaxed);
+        currentPhase = id;
+    }
+    return previous;
+}
+
+// restores the previous phase
+void AllocationTracker::leave(int id, int previous) {
+    if (id >= 0) {
+        currentPhase = previous;
+    }
+}
+
+// logs allocations and bytes of every phase
+void AllocationTracker::report() {
+    int count = phaseCount.load();
+    for (int i = 0; i < count; i++) {
+        uint64_t entries = phases[i].entries.load();
+        uint64_t allocations = phases[i].allocations.load();
+        uint64_t bytes = phases[i].bytes.load();
+        spdlog::info("Allocations in {}: {} allocations, {} bytes over {} calls ({:.1f} allocations/call)",
+            phases[i].name, allocations, bytes, entries,
+            entries > 0 ? (double) allocations / entries : 0.0);
+    }
+}
+
+static void countAllocation(size_t size) {
+    total.fetch_add(1, std::memory_order_relaxed);
+    int id = currentPhase;
+    if (id >= 0) {
+        phases[id].allocations.fetch_add(1, std::memory_order_relaxed);
+        phases[id].bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+}
+
+void *operator new(size_t size) {
+    countAllocation(size);
+    void *p = malloc(size > 0 ? size : 1);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+    free(p);
+}
+
+#endif
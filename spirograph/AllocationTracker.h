@@ -0,0 +1,61 @@
+#ifndef __ALLOCATIONTRACKER_H__
+#define __ALLOCATIONTRACKER_H__
+
+// Header for heap allocation tracking of Spirograph program.
+//
+// ALLOC_PHASE("name") attributes every heap allocation made by the calling
+// thread to the named phase until the enclosing scope ends (the innermost
+// phase wins when they nest). ALLOC_REPORT() logs the counts of each phase
+// through spdlog; ALLOC_COUNT("name") is the running allocation count of a
+// phase, for checks such as "this frame did not allocate".
+//
+// Tracking replaces the global operator new, so it only exists when built
+// with SPIROGRAPH_TRACK_ALLOCATIONS defined (make ALLOC_TRACKING=1).
+// Otherwise the macros expand to nothing.
+
+#ifdef SPIROGRAPH_TRACK_ALLOCATIONS
+
+#include <cstdint>
+
+#define ALLOC_CONCAT_(a, b) a##b
+#define ALLOC_CONCAT(a, b) ALLOC_CONCAT_(a, b)
+#define ALLOC_PHASE(name) \
+    static const int ALLOC_CONCAT(allocPhaseId, __LINE__) = AllocationTracker::phaseId(name); \
+    AllocationPhase ALLOC_CONCAT(allocPhase, __LINE__)(ALLOC_CONCAT(allocPhaseId, __LINE__))
+#define ALLOC_COUNT(name) AllocationTracker::allocations(AllocationTracker::phaseId(name))
+#define ALLOC_REPORT() AllocationTracker::report()
+
+class AllocationTracker
+{
+public:
+    static const int MAX_PHASES = 32;
+
+    static int phaseId(const char *name); // id of the named phase, registered on first use
+    static uint64_t allocations(int id); // allocations made so far in a phase
+    static uint64_t totalAllocations(); // allocations made so far, in or outside of phases
+    static void report(); // logs allocations and bytes of every phase
+    static int enter(int id); // makes id the current phase, returns the previous one
+    static void leave(int id, int previous); // restores the previous phase
+};
+
+// Makes a phase current for its own lifetime.
+class AllocationPhase
+{
+public:
+    AllocationPhase(int id) : id(id) { previous = AllocationTracker::enter(id); }
+    ~AllocationPhase() { AllocationTracker::leave(id, previous); }
+
+private:
+    int id;
+    int previous; // phase to go back to
+};
+
+#else
+
+#define ALLOC_PHASE(name) ((void)0)
+#define ALLOC_COUNT(name) 0
+#define ALLOC_REPORT() ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,73 @@
+#include "ArcLengthTable.h"
+#include <algorithm>
+
+// Implementation of ArcLengthTable of Program.
+
+ArcLengthTable::ArcLengthTable() {
+}
+
+// removes all entries
+void ArcLengthTable::clear() {
+    parameters.clear();
+    lengths.clear();
+    length = CompensatedSum();
+}
+
+// makes room for entries without reallocating
+void ArcLengthTable::reserve(int entries) {
+    parameters.reserve(entries);
+    lengths.reserve(entries);
+}
+
+// appends an entry segmentLength past the last one
+void ArcLengthTable::add(double parameter, double segmentLength) {
+    // the first entry is at 0 whatever its segment length
+    if (!lengths.empty()) {
+        length.add(segmentLength);
+    }
+    parameters.push_back(parameter);
+    lengths.push_back(length.get());
+}
+
+// number of entries
+int ArcLengthTable::getSize() const {
+    return lengths.size();
+}
+
+// arc length of the whole table
+double ArcLengthTable::getLength() const {
+    return lengths.empty() ? 0 : lengths.back();
+}
+
+// parameter of entry i
+double ArcLengthTable::getParameter(int i) const {
+    return parameters[i];
+}
+
+// arc length at entry i
+double ArcLengthTable::getArcLength(int i) const {
+    return lengths[i];
+}
+
+// entry starting the segment that contains arc length s, never before entry from;
+// lengths outside the table give its first or last segment
+int ArcLengthTable::findSegment(double s, int from) const {
+    if (lengths.size() < 2) {
+        return 0;
+    }
+    // first entry past s, the segment starts one before it
+    vector<double>::const_iterator it = upper_bound(lengths.begin() + from, lengths.end() - 1, s);
+    int i = (it - lengths.begin()) - 1;
+    return max(i, from);
+}
+
+// parameter at arc length s, interpolated linearly within its segment
+double ArcLengthTable::parameterAt(double s) const {
+    if (lengths.size() < 2) {
+        return parameters.empty() ? 0 : parameters[0];
+    }
+    int i = findSegment(s);
+    double segment = lengths[i + 1] - lengths[i];
+    double t = segment > 0 ? (s - lengths[i]) / segment : 0;
+    return parameters[i] + (parameters[i + 1] - parameters[i]) * t;
+}
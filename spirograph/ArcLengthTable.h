@@ -0,0 +1,39 @@
+#ifndef __ARCLENGTHTABLE_H__
+#define __ARCLENGTHTABLE_H__
+
+#include <vector>
+#include "CompensatedSum.h"
+using namespace std;
+
+// Header for ArcLengthTable of Spirograph program.
+// Cumulative arc length of a curve at increasing values of its parameter,
+// for finding the parameter at which a given length along the curve is
+// reached. Entries are appended in parameter order; the first entry is at
+// arc length 0.
+
+class ArcLengthTable
+{
+public:
+    ArcLengthTable();
+    void clear(); // removes all entries
+    void reserve(int entries); // makes room for entries without reallocating
+    void add(double parameter, double segmentLength); // appends an entry segmentLength past the last one
+    int getSize() const; // number of entries
+    double getLength() const; // arc length of the whole table
+    double getParameter(int i) const; // parameter of entry i
+    double getArcLength(int i) const; // arc length at entry i
+
+    // entry starting the segment that contains arc length s (binary search),
+    // looking no further back than entry "from" (for increasing lookups)
+    int findSegment(double s, int from = 0) const;
+
+    // parameter at arc length s, interpolated linearly within its segment
+    double parameterAt(double s) const;
+
+private:
+    vector<double> parameters;
+    vector<double> lengths; // cumulative arc length at each parameter
+    CompensatedSum length; // of the whole table, summed without losing precision
+};
+
+#endif
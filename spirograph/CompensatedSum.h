@@ -0,0 +1,32 @@
+#ifndef __COMPENSATEDSUM_H__
+#define __COMPENSATEDSUM_H__
+
+// Header for CompensatedSum of Spirograph program.
+// A running sum of many small terms (Kahan summation). The rounding error
+// of every addition is kept and taken off the next term, so the error of
+// the sum stays at a few units in the last place instead of growing with
+// the number of terms. Needs strict floating point: not -ffast-math.
+
+class CompensatedSum
+{
+public:
+    CompensatedSum(double value = 0) : sum(value), compensation(0) {}
+
+    void add(double term) {
+        double corrected = term - compensation;
+        double next = sum + corrected;
+        // what of corrected did not make it into next
+        compensation = (next - sum) - corrected;
+        sum = next;
+    }
+
+    double get() const {
+        return sum;
+    }
+
+private:
+    double sum;
+    double compensation; // rounding error of the last addition
+};
+
+#endif
@@ -2,10 +2,13 @@
 #include <cstdio>
 #include <cstdlib>
 #include <fstream>
+#include "StartupProfiler.h"
+#include "Trace.h"
+#include "AllocationTracker.h"
 
 // Implementation of Controller of Program.
 
-Controller::Controller(Model* m,View* v) {
+Controller::Controller(Model* m,View* v) : simulation(m) {
     model = m;
     view = v;
 }
@@ -16,13 +19,25 @@ Controller::~Controller()
 }
 
 // program runs in a loop until window is closed
+// this thread draws and handles events (display() polls them), while the
+// simulation moves the pen and regenerates the curve on its own thread
 void Controller::run()
 {
-    view->init(model);
+    view->init(model, &simulation);
+    simulation.start(view->isDriven());
+    {
+        StartupSpan span("first frame");
+        view->display();
+    }
+    StartupProfiler::finish();
+    simulation.startPrefetching();
     while (!view->shouldWindowClose()) {
         view->display();
-        glfwPollEvents();
     }
+    simulation.stop();
+    model->logCurveCacheStats();
     view->closeWindow();
+    TRACE_STOP();
+    ALLOC_REPORT();
     exit(EXIT_SUCCESS);
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <map>
 #include "View.h"
 #include "Model.h"
+#include "Simulation.h"
 
 // Header for Controller of Spirograph program.
 
@@ -17,6 +18,7 @@ public:
 private:
     View* view;
     Model* model;
+    Simulation simulation; // pen and parameter changes, on a thread of its own
 };
 
 #endif
@@ -0,0 +1,118 @@
+#include "CurveMorph.h"
+#include <cmath>
+#include <algorithm>
+#include "Trace.h"
+
+// Implementation of CurveMorph of Program.
+
+// turns the pattern of integer radii takes to close, r / gcd(R, r)
+static double patternTurns(int bigRadius, int smallRadius) {
+    int a = bigRadius;
+    int b = smallRadius;
+    while (b != 0) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return (double) smallRadius / max(a, 1);
+}
+
+CurveMorph::CurveMorph() {
+    vao = 0;
+    seconds = MORPH_SECONDS;
+    startTime = 0;
+    bigRadius = 0;
+    outside = false;
+    started = false;
+    penCount = 0;
+    fromRadius = 0;
+    toRadius = 0;
+}
+
+// makes the empty vertex array drawn from, while there is a context
+void CurveMorph::init(double seconds) {
+    this->seconds = seconds;
+    glGenVertexArrays(1, &vao);
+}
+
+// frees it, while there still is a context
+void CurveMorph::clear() {
+    if (vao != 0) {
+        glDeleteVertexArrays(1, &vao);
+        vao = 0;
+    }
+}
+
+// eases from the curve drawn at now to this one; the first call only sets it
+void CurveMorph::setTarget(int bigRadius, int smallRadius, bool outside,
+                           const double *penOffsets, int penCount, double now) {
+    if (started && smallRadius == toRadius && outside == this->outside && penCount == this->penCount
+        && equal(penOffsets, penOffsets + penCount, toOffsets)) {
+        return;
+    }
+    // rolling the other way, or another pen count, has nothing to ease between
+    if (started && outside == this->outside && penCount == this->penCount) {
+        // a new target during a morph starts from where the curve is now
+        double progress = getProgress(now);
+        fromRadius = fromRadius + (toRadius - fromRadius) * progress;
+        for (int i = 0; i < penCount; i++) {
+            fromOffsets[i] = fromOffsets[i] + (toOffsets[i] - fromOffsets[i]) * progress;
+        }
+        startTime = now;
+    }
+    else {
+        fromRadius = smallRadius;
+        copy(penOffsets, penOffsets + penCount, fromOffsets);
+        startTime = now - seconds;
+    }
+    copy(penOffsets, penOffsets + penCount, toOffsets);
+    this->bigRadius = bigRadius;
+    this->outside = outside;
+    this->penCount = penCount;
+    toRadius = smallRadius;
+    started = true;
+}
+
+// false once the target has been reached
+bool CurveMorph::isMorphing(double now) {
+    return started && seconds > 0 && now - startTime < seconds;
+}
+
+// 0 at the start of the morph, 1 at its end, easing in and out
+double CurveMorph::getProgress(double now) {
+    if (seconds <= 0) {
+        return 1;
+    }
+    double t = min(max((now - startTime) / seconds, 0.0), 1.0);
+    return t * t * (3 - 2 * t);
+}
+
+// The curve of the frame over as many turns as the longer of the patterns
+// it morphs between takes to close (at most as many as a train of gears
+// is drawn over), MORPH_POINTS points a fixed angle apart. The shader is
+// given the turns of the centre and of the pen per point, and per 1024
+// points less whole turns, worked out here in double.
+void CurveMorph::draw(const util::ShaderLocationsVault& shaderLocations, double now) {
+    TRACE_SCOPE("CurveMorph::draw");
+    double progress = getProgress(now);
+    double radius = fromRadius + (toRadius - fromRadius) * progress;
+    double turns = max(patternTurns(bigRadius, (int) fromRadius), patternTurns(bigRadius, (int) toRadius));
+    turns = min(turns, MAX_GEAR_TRAIN_ANGLE / (2 * M_PI));
+    double distance = outside ? bigRadius + radius : bigRadius - radius;
+    double rate = outside ? 1 + bigRadius / radius : 1 - bigRadius / radius;
+    double centreStep = turns / (MORPH_POINTS - 1);
+    double penStep = rate * centreStep;
+    double unused;
+
+    glUniform1i(shaderLocations.getLocation("evaluated"), 1);
+    glUniform4f(shaderLocations.getLocation("phaseSteps"), (float) centreStep, (float) penStep,
+                (float) modf(1024 * centreStep, &unused), (float) modf(1024 * penStep, &unused));
+    glBindVertexArray(vao);
+    for (int i = 0; i < penCount; i++) {
+        double penOffset = fromOffsets[i] + (toOffsets[i] - fromOffsets[i]) * progress;
+        glUniform2f(shaderLocations.getLocation("arms"), (float) distance, (float) penOffset);
+        glDrawArrays(GL_LINE_STRIP, 0, MORPH_POINTS);
+    }
+    glBindVertexArray(0);
+    glUniform1i(shaderLocations.getLocation("evaluated"), 0);
+}
@@ -0,0 +1,48 @@
+#ifndef __CURVEMORPH_H__
+#define __CURVEMORPH_H__
+
+#include <glad/glad.h>
+#include <ShaderLocationsVault.h>
+#include "Model.h"
+
+// Header for CurveMorph of Spirograph program.
+// Eases the drawn curve from one inner radius to the next instead of
+// jumping, for a single inner circle rolling inside or outside the outer
+// one. While it runs, the vertex shader works out every point of the
+// curve from its index for the radius of the frame, so nothing is
+// generated or uploaded; a frame costs one draw of MORPH_POINTS vertices
+// per pen without any vertex buffer.
+
+#define MORPH_POINTS 50000 // points of the curve drawn while morphing
+#define MORPH_SECONDS 0.25 // length of a morph, unless set
+
+class CurveMorph
+{
+public:
+    CurveMorph();
+    void init(double seconds); // makes the empty vertex array drawn from, while there is a context
+    void clear(); // frees it, while there still is a context
+
+    // eases from the curve drawn at now to this one; the first call only sets it
+    void setTarget(int bigRadius, int smallRadius, bool outside,
+                   const double *penOffsets, int penCount, double now);
+    bool isMorphing(double now); // false once the target has been reached
+    void draw(const util::ShaderLocationsVault& shaderLocations, double now); // the curve of the frame
+
+private:
+    GLuint vao; // without attributes, the shader needs no vertices
+    double seconds;
+    double startTime; // of the morph, glfwGetTime()
+    int bigRadius;
+    bool outside;
+    bool started; // setTarget has been called
+    int penCount;
+    double fromRadius; // inner radius at the start of the morph
+    double toRadius;
+    double fromOffsets[MAX_PENS]; // pen offsets at the start of the morph, in model units
+    double toOffsets[MAX_PENS];
+
+    double getProgress(double now); // 0 at the start of the morph, 1 at its end, eased
+};
+
+#endif
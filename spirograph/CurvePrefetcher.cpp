@@ -0,0 +1,119 @@
+#include "CurvePrefetcher.h"
+#include <chrono>
+#include <cstdlib>
+#include <GLFW/glfw3.h>
+#include "spdlog/spdlog.h"
+#include "Trace.h"
+
+// Implementation of CurvePrefetcher of Program.
+
+CurvePrefetcher::CurvePrefetcher(Model *m) : running(false), next(0), requestTime(0), made(0), cancelled(0) {
+    model = m;
+
+    // radii on either side to prefetch (SPIROGRAPH_PREFETCH_STEPS=0 turns prefetching off)
+    const char *stepsValue = getenv("SPIROGRAPH_PREFETCH_STEPS");
+    steps = stepsValue != NULL ? max(atoi(stepsValue), 0) : 2;
+
+    // largest fraction of one core spent prefetching
+    const char *cpuValue = getenv("SPIROGRAPH_PREFETCH_CPU");
+    cpuShare = cpuValue != NULL ? atof(cpuValue) : 0.25;
+    cpuShare = min(max(cpuShare, 0.01), 1.0);
+}
+
+CurvePrefetcher::~CurvePrefetcher() {
+    stop();
+}
+
+// starts the thread, which makes the model the curves are made on
+void CurvePrefetcher::start() {
+    if (steps == 0 || running) {
+        return;
+    }
+    running = true;
+    thread = std::thread(&CurvePrefetcher::run, this);
+}
+
+// cancels the work left and stops the thread, returns once it has finished
+void CurvePrefetcher::stop() {
+    {
+        lock_guard<mutex> guard(lock);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+    wake.notify_one();
+    thread.join();
+    spdlog::info("Curve prefetch: {} curves made, {} requests cancelled", made, cancelled);
+}
+
+// prefetches the radii around key from now on, nearest first
+void CurvePrefetcher::request(const CurveKey& key) {
+    {
+        lock_guard<mutex> guard(lock);
+        if (next < queue.size()) {
+            cancelled++;
+        }
+        queue.clear();
+        next = 0;
+        // the radius makes no difference to a Fourier curve or to a shaped gear
+        int radii = key.fourierCurve || key.gearShape ? 0 : steps;
+        for (int i = 1; i <= radii; i++) {
+            // the larger radius first, as the pattern gets simpler that way
+            for (int sign = 1; sign >= -1; sign -= 2) {
+                int radius = key.smallRadius + sign * i * RADIUS_STEP;
+                if (radius < MIN_SMALL_RADIUS || radius > MAX_SMALL_RADIUS) {
+                    continue;
+                }
+                CurveKey neighbour = key;
+                neighbour.smallRadius = radius;
+                queue.push_back(neighbour);
+            }
+        }
+        requestTime = glfwGetTime();
+    }
+    wake.notify_one();
+}
+
+// body of the prefetch thread
+void CurvePrefetcher::run() {
+    // a new model samples its default curve, which is no work for the thread that started this one
+    worker.reset(new Model());
+    worker->setSamplingThreads(1);
+    unique_lock<mutex> guard(lock);
+    while (running) {
+        if (next >= queue.size()) {
+            wake.wait(guard);
+            continue;
+        }
+
+        // wait until the parameters have stayed the same for a moment,
+        // so that a held key does not have the thread make curves nobody sees
+        double idle = glfwGetTime() - requestTime;
+        if (idle < PREFETCH_IDLE_DELAY) {
+            wake.wait_for(guard, std::chrono::duration<double>(PREFETCH_IDLE_DELAY - idle));
+            continue;
+        }
+
+        CurveKey key = queue[next];
+        next++;
+        guard.unlock();
+        double elapsed = 0;
+        if (!model->hasCurve(key)) {
+            TRACE_SCOPE("CurvePrefetcher::makeCurve");
+            double start = glfwGetTime();
+            worker->setCurveKey(key);
+            shared_ptr<const CurveData> curve = worker->makeCurve();
+            model->addCurve(curve);
+            elapsed = glfwGetTime() - start;
+        }
+        guard.lock();
+        if (elapsed > 0) {
+            made++;
+            // rest long enough to keep to cpuShare of a core, new requests
+            // wait for the rest too; only stopping cuts it short
+            double rest = elapsed * (1 - cpuShare) / cpuShare;
+            wake.wait_for(guard, std::chrono::duration<double>(rest), [this]() { return !running; });
+        }
+    }
+}
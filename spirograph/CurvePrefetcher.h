@@ -0,0 +1,55 @@
+#ifndef __CURVEPREFETCHER_H__
+#define __CURVEPREFETCHER_H__
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Model.h"
+
+// Header for CurvePrefetcher of Spirograph program.
+// The inner radius only ever changes by RADIUS_STEP, so the next curve
+// asked for is almost always a neighbour of the current one. Once the
+// parameters have stayed the same for a moment, a thread of its own makes
+// the curves of the nearest radii on a model of its own and puts them in
+// the curve cache of the shared model. A new request cancels what is left
+// of the previous one, and the thread sleeps between curves so that it
+// takes no more than its share of one core.
+
+#define PREFETCH_IDLE_DELAY 0.1 // seconds the parameters must stay the same before prefetching
+
+class CurvePrefetcher
+{
+public:
+    CurvePrefetcher(Model *m);
+    ~CurvePrefetcher();
+
+    // starts the thread, which makes the model the curves are made on; called
+    // after startup, as making a model records startup spans
+    void start();
+    void stop(); // cancels the work left and stops the thread, returns once it has finished
+
+    // prefetches the radii around key from now on, cancelling the previous request
+    void request(const CurveKey& key);
+
+private:
+    Model *model; // whose curve cache is filled
+    unique_ptr<Model> worker; // makes the curves, only used on the thread
+    int steps; // radii on either side to prefetch, 0 for none
+    double cpuShare; // largest fraction of one core the thread takes
+
+    mutex lock; // guards everything below
+    condition_variable wake;
+    bool running;
+    vector<CurveKey> queue; // curves of the latest request, nearest first
+    unsigned int next; // first curve of queue not looked at yet
+    double requestTime; // glfwGetTime() of the latest request
+    unsigned long made; // curves made and cached
+    unsigned long cancelled; // requests replaced before they were done
+    std::thread thread;
+
+    void run(); // body of the prefetch thread
+};
+
+#endif
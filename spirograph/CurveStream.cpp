@@ -0,0 +1,120 @@
+#include "CurveStream.h"
+#include <cmath>
+#include <algorithm>
+#include "Trace.h"
+
+// Implementation of CurveStream of Program.
+
+CurveStream::CurveStream() {
+    capacity = 0;
+    step = 0;
+    startAngle = 0;
+    streamedPoints = 0;
+    head = 0;
+    size = 0;
+}
+
+// streams into object, which holds MAX_PENS rings of capacity + 1 vertices
+void CurveStream::init(const shared_ptr<util::ObjectInstance>& object, int capacity) {
+    this->object = object;
+    this->capacity = capacity;
+    penOffsets.clear();
+}
+
+// frees the buffer, while there still is a context
+void CurveStream::clear() {
+    object.reset();
+}
+
+// restart has been called since init
+bool CurveStream::isStarted() {
+    return !penOffsets.empty();
+}
+
+// the trail is of these gears and pens, so it goes on rather than starting again
+bool CurveStream::isFollowing(const GearTrain& train, const double *penOffsets, int penCount) {
+    return isStarted() && this->train == train && (int) this->penOffsets.size() == penCount
+        && equal(penOffsets, penOffsets + penCount, this->penOffsets.begin());
+}
+
+// The step keeps every gear from turning more than STREAM_MAX_TURN between
+// points, so the trail is as smooth at small radii as at large ones.
+void CurveStream::restart(const GearTrain& train, const double *penOffsets, int penCount, double theta) {
+    this->train = train;
+    this->penOffsets.assign(penOffsets, penOffsets + penCount);
+    step = STREAM_MAX_TURN / train.getFastestRate();
+    // room for the most points of a frame, so that advancing does not allocate
+    points.resize(penCount);
+    for (unsigned int i = 0; i < points.size(); i++) {
+        points[i].reserve(capacity);
+    }
+    startAngle = theta;
+    streamedPoints = 0;
+    head = 0;
+    size = 0;
+    advance(theta);
+}
+
+// appends the points the pens have passed up to theta, at most capacity of them
+void CurveStream::advance(double theta) {
+    TRACE_SCOPE("CurveStream::advance");
+    if (!object || penOffsets.empty()) {
+        return;
+    }
+    // point i is at startAngle + i step, counted rather than summed so that
+    // no rounding builds up however long the pen runs
+    long long last = (long long) floor((theta - startAngle) / step);
+    if (last < streamedPoints) {
+        return;
+    }
+    // older points than a ring holds would be overwritten in the same upload
+    streamedPoints = max(streamedPoints, last + 1 - capacity);
+    int count = (int) (last + 1 - streamedPoints);
+    for (unsigned int i = 0; i < points.size(); i++) {
+        points[i].clear();
+    }
+    train.sample(count, step, penOffsets, points, startAngle + streamedPoints * step);
+    streamedPoints = last + 1;
+
+    // up to the end of the rings, then from their start
+    int firstRun = min(count, capacity - head);
+    for (unsigned int pen = 0; pen < points.size(); pen++) {
+        upload(pen, 0, head, firstRun);
+        if (count > firstRun) {
+            upload(pen, firstRun, 0, count - firstRun);
+        }
+    }
+    head = (head + count) % capacity;
+    size = min(size + count, capacity);
+}
+
+// writes count points from points[pen][first] on into the ring of pen from
+// point index on, and the first point of the ring once more after its last
+void CurveStream::upload(int pen, int first, int index, int count) {
+    unsigned int ring = pen * (capacity + 1);
+    const unsigned int vertexSize = sizeof(glm::vec4);
+    object->updateVertexData((ring + index) * vertexSize, count * vertexSize, &points[pen][first]);
+    if (index == 0) {
+        object->updateVertexData((ring + capacity) * vertexSize, vertexSize, &points[pen][first]);
+    }
+}
+
+// every trail, oldest point first: in one range, or in two once the newest
+// points have wrapped around to the start of the ring
+void CurveStream::draw() {
+    if (!object || size < 2) {
+        return;
+    }
+    int oldest = (head - size + capacity) % capacity;
+    for (unsigned int pen = 0; pen < penOffsets.size(); pen++) {
+        int ring = pen * (capacity + 1);
+        if (oldest + size <= capacity) {
+            object->drawRange(ring + oldest, size);
+        }
+        else {
+            // up to the copy of the first point, then on from the first point
+            object->drawRange(ring + oldest, capacity + 1 - oldest);
+            object->drawRange(ring, head);
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef __CURVESTREAM_H__
+#define __CURVESTREAM_H__
+
+#include <glad/glad.h>
+#include <memory>
+#include <vector>
+#include <ObjectInstance.h>
+#include "GearTrain.h"
+#include "Model.h"
+using namespace std;
+
+// Header for CurveStream of Spirograph program.
+// Draws the trail of the pens instead of the whole curve, so that a curve
+// that takes very long to close (or is cut off by the fixed number of
+// points of a generated curve) is drawn for as long as the pen runs. Every
+// frame the points the pens have passed since the last frame are sampled
+// from the GearTrain and written into a vertex buffer of fixed size, one
+// ring of capacity points per pen, over the oldest ones. A ring that has
+// wrapped around is drawn as two ranges; the first point of a ring is kept
+// once more after its last, so that the two ranges join up.
+
+#define STREAM_MAX_TURN (2 * M_PI / 64) // largest turn of any gear from one streamed point to the next
+
+class CurveStream
+{
+public:
+    CurveStream();
+
+    // streams into object, which holds MAX_PENS rings of capacity + 1 vertices
+    void init(const shared_ptr<util::ObjectInstance>& object, int capacity);
+    void clear(); // frees the buffer, while there still is a context
+    bool isStarted(); // restart has been called since init
+    // the trail is of these gears and pens, so it goes on rather than starting again
+    bool isFollowing(const GearTrain& train, const double *penOffsets, int penCount);
+
+    // forgets the trail and starts one for these gears and pens at theta
+    void restart(const GearTrain& train, const double *penOffsets, int penCount, double theta);
+
+    // appends the points the pens have passed up to theta, at most capacity of them
+    void advance(double theta);
+    void draw(); // every trail, oldest point first
+
+private:
+    shared_ptr<util::ObjectInstance> object; // the rings, one after another
+    int capacity; // points of each ring
+    GearTrain train;
+    vector<double> penOffsets;
+    double step; // angle from one point to the next
+    double startAngle; // angle of the first point of the trail
+    long long streamedPoints; // points of the trail so far
+    int head; // next point of every ring to write
+    int size; // points written into every ring, at most capacity
+    vector<vector<glm::vec4> > points; // new points of every pen, reused every frame
+
+    // writes count points from points[pen][first] on into the ring of pen from point index on
+    void upload(int pen, int first, int index, int count);
+};
+
+#endif
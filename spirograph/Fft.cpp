@@ -0,0 +1,78 @@
+#include "Fft.h"
+#include <cmath>
+
+// Implementation of Fft of Program.
+
+Fft::Fft(int size) : size(size) {
+    int bits = 0;
+    while ((1 << bits) < size) {
+        bits++;
+    }
+    reversed.resize(size);
+    for (int i = 0; i < size; i++) {
+        int r = 0;
+        for (int b = 0; b < bits; b++) {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        reversed[i] = r;
+    }
+    // every twiddle from sin and cos, as a recurrence would lose digits over long transforms
+    twiddles.resize(size / 2);
+    for (int k = 0; k < size / 2; k++) {
+        double angle = -2 * M_PI * k / size;
+        twiddles[k] = complex<double>(cos(angle), sin(angle));
+    }
+}
+
+int Fft::getSize() const {
+    return size;
+}
+
+// X_k = sum_n x_n e^(-2 pi i k n / size)
+void Fft::forward(vector<complex<double> >& data) const {
+    transform(data, false);
+}
+
+// x_n = sum_k X_k e^(2 pi i k n / size), without dividing by size
+void Fft::inverse(vector<complex<double> >& data) const {
+    transform(data, true);
+}
+
+// smallest power of two at least n
+int Fft::nextPowerOfTwo(int n) {
+    int power = 1;
+    while (power < n) {
+        power = power * 2;
+    }
+    return power;
+}
+
+// Cooley-Tukey: after putting the data in bit-reversed order, each pass
+// combines pairs of transforms of half the length with butterflies. The
+// inverse uses the conjugate twiddles. The products are written out, as
+// complex<double> multiplication checks for infinities on every call.
+void Fft::transform(vector<complex<double> >& data, bool inverse) const {
+    for (int i = 0; i < size; i++) {
+        int j = reversed[i];
+        if (i < j) {
+            swap(data[i], data[j]);
+        }
+    }
+    for (int length = 2; length <= size; length = length * 2) {
+        int half = length / 2;
+        int stride = size / length; // between the twiddles of this pass
+        for (int start = 0; start < size; start += length) {
+            for (int k = 0; k < half; k++) {
+                const complex<double>& w = twiddles[k * stride];
+                double wr = w.real();
+                double wi = inverse ? -w.imag() : w.imag();
+                complex<double>& a = data[start + k];
+                complex<double>& b = data[start + k + half];
+                double br = b.real() * wr - b.imag() * wi;
+                double bi = b.real() * wi + b.imag() * wr;
+                b = complex<double>(a.real() - br, a.imag() - bi);
+                a = complex<double>(a.real() + br, a.imag() + bi);
+            }
+        }
+    }
+}
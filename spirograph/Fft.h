@@ -0,0 +1,35 @@
+#ifndef __FFT_H__
+#define __FFT_H__
+
+#include <complex>
+#include <vector>
+using namespace std;
+
+// Header for Fft of Spirograph program.
+// Iterative radix-2 fast Fourier transform of a fixed power-of-two size,
+// in place. The twiddle factors and the bit-reversed order are worked out
+// once when it is made, so one Fft can transform many arrays.
+
+class Fft
+{
+public:
+    Fft(int size); // size must be a power of two
+    int getSize() const;
+
+    // X_k = sum_n x_n e^(-2 pi i k n / size)
+    void forward(vector<complex<double> >& data) const;
+
+    // x_n = sum_k X_k e^(2 pi i k n / size), without dividing by size
+    void inverse(vector<complex<double> >& data) const;
+
+    static int nextPowerOfTwo(int n); // smallest power of two at least n
+
+private:
+    int size;
+    vector<complex<double> > twiddles; // e^(-2 pi i k / size) for k < size / 2
+    vector<int> reversed; // index with its bits reversed
+
+    void transform(vector<complex<double> >& data, bool inverse) const;
+};
+
+#endif
@@ -0,0 +1,195 @@
+#include "FourierCurve.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include "spdlog/spdlog.h"
+#include "Fft.h"
+#include "ArcLengthTable.h"
+#include "Trace.h"
+
+// Implementation of FourierCurve of Program.
+
+FourierCurve::FourierCurve() {
+}
+
+FourierCurve::FourierCurve(const vector<FourierTerm>& terms) : terms(terms) {
+}
+
+static bool isLarger(const FourierTerm& a, const FourierTerm& b) {
+    return norm(a.coefficient) > norm(b.coefficient);
+}
+
+// the coefficient of frequency k of points evenly spaced over a turn of t
+// is X_k / M for the forward transform X of the M points
+FourierCurve FourierCurve::fit(const vector<glm::vec2>& points, int termCount, double radius) {
+    TRACE_SCOPE("FourierCurve::fit");
+    int pointCount = points.size();
+    if (pointCount < 2 || termCount < 1) {
+        return FourierCurve();
+    }
+
+    // arc length around the closed polyline, by vertex index
+    ArcLengthTable table;
+    table.reserve(pointCount + 1);
+    table.add(0, 0);
+    for (int i = 1; i <= pointCount; i++) {
+        table.add(i, glm::length(points[i % pointCount] - points[i - 1]));
+    }
+
+    // evenly respaced, at least as many points as the polyline and enough for the terms
+    int size = Fft::nextPowerOfTwo(max(max(pointCount, 2 * termCount + 1), 256));
+    vector<complex<double> > data(size);
+    double spacing = table.getLength() / size;
+    int segment = 0;
+    for (int i = 0; i < size; i++) {
+        double s = i * spacing;
+        segment = table.findSegment(s, segment);
+        double length1 = table.getArcLength(segment);
+        double length2 = table.getArcLength(segment + 1);
+        double fraction = length2 > length1 ? (s - length1) / (length2 - length1) : 0;
+        glm::vec2 a = points[segment % pointCount];
+        glm::vec2 b = points[(segment + 1) % pointCount];
+        glm::vec2 p = a + (float) fraction * (b - a);
+        data[i] = complex<double>(p.x, p.y);
+    }
+
+    Fft fft(size);
+    fft.forward(data);
+
+    // the constant term is the centre, which goes to the origin
+    vector<FourierTerm> fitted;
+    fitted.reserve(size - 1);
+    for (int k = 1; k < size; k++) {
+        FourierTerm term;
+        term.frequency = k < size / 2 ? k : k - size;
+        term.coefficient = data[k] / (double) size;
+        fitted.push_back(term);
+    }
+    termCount = min(termCount, (int) fitted.size());
+    partial_sort(fitted.begin(), fitted.begin() + termCount, fitted.end(), isLarger);
+    fitted.resize(termCount);
+
+    FourierCurve curve(fitted);
+    // scale by the furthest point of the fitted curve
+    vector<glm::vec4> positions;
+    curve.sample(size, positions);
+    double furthest = 0;
+    for (unsigned int i = 0; i < positions.size(); i++) {
+        furthest = max(furthest, (double) glm::length(glm::vec2(positions[i])));
+    }
+    if (furthest > 0) {
+        for (unsigned int i = 0; i < curve.terms.size(); i++) {
+            curve.terms[i].coefficient = curve.terms[i].coefficient * (radius / furthest);
+        }
+    }
+    return curve;
+}
+
+// reads coefficients or a polyline to fit from a text file
+bool FourierCurve::load(const char *file, int termCount, double radius, FourierCurve& curve) {
+    FILE *in = fopen(file, "r");
+    if (in == NULL) {
+        spdlog::error("Could not open {} to read a Fourier curve", file);
+        return false;
+    }
+    vector<FourierTerm> terms;
+    vector<glm::vec2> points;
+    char line[256];
+    int lineNumber = 0;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        lineNumber++;
+        double a, b, c;
+        char first;
+        if (sscanf(line, " %c", &first) != 1 || first == '#') {
+            continue;
+        }
+        int count = sscanf(line, "%lf %lf %lf", &a, &b, &c);
+        if (count == 3) {
+            if (!(fabs(a) <= MAX_FREQUENCY)) {
+                spdlog::error("{}:{} has a frequency beyond {}", file, lineNumber, MAX_FREQUENCY);
+                fclose(in);
+                return false;
+            }
+            FourierTerm term;
+            term.frequency = (int) a;
+            term.coefficient = complex<double>(b, c);
+            terms.push_back(term);
+        }
+        else if (count == 2) {
+            points.push_back(glm::vec2(a, b));
+        }
+        else {
+            spdlog::error("{}:{} is neither a coefficient nor a point", file, lineNumber);
+            fclose(in);
+            return false;
+        }
+    }
+    fclose(in);
+
+    if (!terms.empty() && !points.empty()) {
+        spdlog::error("{} mixes coefficients and points", file);
+        return false;
+    }
+    if (!terms.empty()) {
+        curve = FourierCurve(terms);
+        spdlog::info("Read {} Fourier coefficients from {}", terms.size(), file);
+        return true;
+    }
+    if (points.size() < 2) {
+        spdlog::error("{} holds no curve", file);
+        return false;
+    }
+    curve = fit(points, termCount, radius);
+    spdlog::info("Fitted {} Fourier terms to {} points from {}", curve.terms.size(), points.size(), file);
+    return true;
+}
+
+// largest first when fitted
+const vector<FourierTerm>& FourierCurve::getTerms() const {
+    return terms;
+}
+
+// largest |frequency| of the terms
+int FourierCurve::getMaxFrequency() const {
+    int highest = 0;
+    for (unsigned int i = 0; i < terms.size(); i++) {
+        highest = max(highest, abs(terms[i].frequency));
+    }
+    return highest;
+}
+
+// e^(2 pi i f n / M) only depends on f modulo M, so adding every
+// coefficient into bin f mod M and transforming once gives
+// p(n / M) = sum_k c_k e^(2 pi i f_k n / M) for all n at once
+void FourierCurve::sample(int count, vector<glm::vec4>& positions) const {
+    TRACE_SCOPE("FourierCurve::sample");
+    int size = Fft::nextPowerOfTwo(max(count, 2 * getMaxFrequency() + 1));
+    vector<complex<double> > data(size);
+    for (unsigned int i = 0; i < terms.size(); i++) {
+        int bin = terms[i].frequency % size;
+        if (bin < 0) {
+            bin = bin + size;
+        }
+        data[bin] += terms[i].coefficient;
+    }
+
+    Fft fft(size);
+    fft.inverse(data);
+
+    positions.reserve(positions.size() + size + 1);
+    for (int i = 0; i <= size; i++) {
+        const complex<double>& p = data[i % size];
+        positions.push_back(glm::vec4(p.real(), p.imag(), 0.0f, 1.0f));
+    }
+}
+
+// sums the series at t directly
+glm::dvec2 FourierCurve::evaluate(double t) const {
+    complex<double> sum(0, 0);
+    for (unsigned int i = 0; i < terms.size(); i++) {
+        double angle = 2 * M_PI * terms[i].frequency * t;
+        sum += terms[i].coefficient * complex<double>(cos(angle), sin(angle));
+    }
+    return glm::dvec2(sum.real(), sum.imag());
+}
@@ -0,0 +1,58 @@
+#ifndef __FOURIERCURVE_H__
+#define __FOURIERCURVE_H__
+
+#include <complex>
+#include <vector>
+#include <glm/glm.hpp>
+using namespace std;
+
+// Header for FourierCurve of Spirograph program.
+// A closed curve given by its Fourier series
+//   p(t) = sum_k c_k e^(2 pi i f_k t),  t in [0, 1)
+// (a spirograph is the series with two terms). The coefficients are read
+// from a file or fitted to a closed polyline. Sampling puts every term
+// in the bin of its frequency modulo the number of points and runs one
+// inverse FFT, which gives the exact sums at all of them in
+// O(M log M) rather than O(N M) for N terms and M points.
+
+// One term of the series.
+struct FourierTerm {
+    int frequency; // turns per turn of t, may be negative
+    complex<double> coefficient; // radius and starting angle of the epicycle
+};
+
+class FourierCurve
+{
+public:
+    // highest |frequency| a file may give; sampling needs more than twice
+    // as many points, so this keeps them to 2^22
+    static const int MAX_FREQUENCY = 1 << 20;
+
+    FourierCurve();
+    FourierCurve(const vector<FourierTerm>& terms);
+
+    // Fits the termCount largest terms to the closed polyline through points,
+    // respaced evenly by arc length first. The curve is centred on the
+    // origin and scaled so that it reaches out to radius.
+    static FourierCurve fit(const vector<glm::vec2>& points, int termCount, double radius);
+
+    // Reads a curve from a text file: lines of "frequency real imaginary"
+    // are coefficients, lines of "x y" a polyline that is fitted as above.
+    // Empty lines and lines starting with # are skipped. False if the file
+    // cannot be read or a frequency is beyond MAX_FREQUENCY.
+    static bool load(const char *file, int termCount, double radius, FourierCurve& curve);
+
+    const vector<FourierTerm>& getTerms() const; // largest first when fitted
+    int getMaxFrequency() const; // largest |frequency| of the terms
+
+    // at least count points evenly spaced in t (a power of two, and enough
+    // to show the highest frequency), then the first again to close the curve
+    void sample(int count, vector<glm::vec4>& positions) const;
+
+    glm::dvec2 evaluate(double t) const; // sums the series at t directly, in double
+
+private:
+    vector<FourierTerm> terms;
+};
+
+#endif
@@ -0,0 +1,286 @@
+#include "GearTrain.h"
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <climits>
+
+// Implementation of GearTrain of Program.
+
+#define RESEED_INTERVAL 1024 // points between exact evaluations of the phasors
+#define PERIOD_LIMIT 1000000LL // largest denominator worked with when finding the period
+
+bool Gear::operator<(const Gear& other) const {
+    if (radius != other.radius) {
+        return radius < other.radius;
+    }
+    return outside < other.outside;
+}
+
+bool Gear::operator==(const Gear& other) const {
+    return radius == other.radius && outside == other.outside;
+}
+
+// product of two complex numbers held as (real, imaginary)
+static inline glm::dvec2 multiply(glm::dvec2 a, glm::dvec2 b) {
+    return glm::dvec2(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+}
+
+// the phasor of length amplitude at angle
+static inline glm::dvec2 phasor(double amplitude, double angle) {
+    return glm::dvec2(amplitude * cos(angle), amplitude * sin(angle));
+}
+
+static long long greatestCommonDivisor(long long a, long long b) {
+    a = llabs(a);
+    b = llabs(b);
+    while (b != 0) {
+        long long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// one gear rolling inside a ring of radius 400, as the Model starts with
+GearTrain::GearTrain() {
+    Gear gear;
+    gear.radius = 200;
+    gear.outside = false;
+    *this = GearTrain(400, &gear, 1);
+}
+
+// Works out the rates from the radii. A gear rolling without slipping on
+// the one before, whose centre goes around that one's at a rate of 1 in
+// its frame, turns 1 - R/r times as fast in that frame (1 + R/r when it
+// rolls around the outside), where R is the radius of the gear before.
+//
+// With whole radii every rate is a fraction n_k / d_k, and the pattern
+// closes after L turns of theta for the smallest L making all n_k L / d_k
+// whole: the least common multiple of the d_k over the greatest common
+// divisor of the numerators brought to that denominator.
+GearTrain::GearTrain(int ringRadius, const Gear *gears, int gearCount) {
+    this->ringRadius = ringRadius;
+    this->gearCount = gearCount < MAX_GEARS ? gearCount : MAX_GEARS;
+    double previousRate = 0; // the ring does not turn
+    int previousRadius = ringRadius;
+    long long numerators[MAX_GEARS + 1];
+    long long denominators[MAX_GEARS + 1];
+    long long rotationNumerator = 0;
+    long long rotationDenominator = 1;
+    bool exact = true;
+    for (int i = 0; i < this->gearCount; i++) {
+        const Gear& gear = gears[i];
+        this->gears[i] = gear;
+        double ratio = (double) previousRadius / gear.radius;
+        distances[i] = gear.outside ? previousRadius + gear.radius : previousRadius - gear.radius;
+        centreRates[i] = previousRate + 1;
+        rotationRates[i] = previousRate + (gear.outside ? 1 + ratio : 1 - ratio);
+        previousRate = rotationRates[i];
+
+        // the centre goes around at the rate the gear before turns, plus one
+        numerators[i] = rotationNumerator + rotationDenominator;
+        denominators[i] = rotationDenominator;
+
+        // and the gear turns (r -+ R) / r faster than the one before
+        long long radius = gear.radius;
+        long long relative = gear.outside ? radius + previousRadius : radius - previousRadius;
+        if (exact) {
+            rotationNumerator = rotationNumerator * radius + relative * rotationDenominator;
+            rotationDenominator = rotationDenominator * radius;
+            long long common = greatestCommonDivisor(rotationNumerator, rotationDenominator);
+            rotationNumerator = rotationNumerator / common;
+            rotationDenominator = rotationDenominator / common;
+            exact = rotationDenominator <= PERIOD_LIMIT;
+        }
+        previousRadius = gear.radius;
+    }
+    // the pens turn with the last gear
+    numerators[this->gearCount] = rotationNumerator;
+    denominators[this->gearCount] = rotationDenominator;
+
+    periodMultiple = 0;
+    periodDivisor = 1;
+    if (!exact) {
+        return;
+    }
+    long long multiple = 1;
+    for (int i = 0; i <= this->gearCount; i++) {
+        multiple = multiple / greatestCommonDivisor(multiple, denominators[i]) * denominators[i];
+        if (multiple > PERIOD_LIMIT) {
+            return;
+        }
+    }
+    long long divisor = 0;
+    for (int i = 0; i <= this->gearCount; i++) {
+        periodTurns[i] = numerators[i] * (multiple / denominators[i]);
+        divisor = greatestCommonDivisor(divisor, periodTurns[i]);
+    }
+    if (divisor == 0) {
+        return;
+    }
+    for (int i = 0; i <= this->gearCount; i++) {
+        periodTurns[i] = periodTurns[i] / divisor;
+    }
+    periodMultiple = multiple;
+    periodDivisor = divisor;
+}
+
+int GearTrain::getRingRadius() const {
+    return ringRadius;
+}
+
+int GearTrain::getGearCount() const {
+    return gearCount;
+}
+
+const Gear& GearTrain::getGear(int i) const {
+    return gears[i];
+}
+
+// the same ring and gears, everything else follows from them
+bool GearTrain::operator==(const GearTrain& other) const {
+    return ringRadius == other.ringRadius && gearCount == other.gearCount
+        && equal(gears, gears + gearCount, other.gears);
+}
+
+// angle after which every gear is back where it started, or maxAngle
+double GearTrain::getPeriod(double maxAngle) const {
+    if (periodMultiple == 0) {
+        return maxAngle;
+    }
+    double period = 2 * M_PI * periodMultiple / periodDivisor;
+    return period < maxAngle ? period : maxAngle;
+}
+
+// theta less whole periods, so that the angles of the phasors stay small
+// however long the pen has run
+double GearTrain::reduce(double theta) const {
+    if (periodMultiple == 0) {
+        return theta;
+    }
+    double period = 2 * M_PI * periodMultiple / periodDivisor;
+    return theta - floor(theta / period) * period;
+}
+
+// centre and rotation of every gear when the first has travelled theta
+// (the rotations within a turn, as a float cannot hold many turns exactly)
+void GearTrain::getPose(double theta, glm::vec2 *centres, float *rotations) const {
+    theta = reduce(theta);
+    glm::dvec2 centre(0, 0);
+    for (int i = 0; i < gearCount; i++) {
+        centre = centre + phasor(distances[i], centreRates[i] * theta);
+        centres[i] = glm::vec2(centre);
+        rotations[i] = (float) fmod(rotationRates[i] * theta, 2 * M_PI);
+    }
+}
+
+// position of a pen penOffset from the centre of the last gear, all in double
+glm::dvec2 GearTrain::getPenPosition(double theta, double penOffset) const {
+    theta = reduce(theta);
+    glm::dvec2 pen(0, 0);
+    for (int i = 0; i < gearCount; i++) {
+        pen = pen + phasor(distances[i], centreRates[i] * theta);
+    }
+    return pen + phasor(penOffset, rotationRates[gearCount - 1] * theta);
+}
+
+// largest number of turns any gear or centre makes per turn of theta
+double GearTrain::getFastestRate() const {
+    double fastest = 0;
+    for (int i = 0; i < gearCount; i++) {
+        fastest = max(fastest, max(fabs(centreRates[i]), fabs(rotationRates[i])));
+    }
+    return fastest;
+}
+
+// Every phasor turns by the same factor from one point to the next, so
+// it is multiplied by that instead of evaluating sin and cos. Rounding
+// would slowly change the lengths of the phasors, so they are evaluated
+// exactly again every RESEED_INTERVAL points.
+void GearTrain::sample(int count, double step, const vector<double>& penOffsets,
+                       vector<vector<glm::vec4> >& pens, double start) const {
+    glm::dvec2 phasors[MAX_GEARS];
+    glm::dvec2 factors[MAX_GEARS];
+    for (int i = 0; i < gearCount; i++) {
+        factors[i] = phasor(1, centreRates[i] * step);
+    }
+    double penRate = rotationRates[gearCount - 1];
+    glm::dvec2 penFactor = phasor(1, penRate * step);
+
+    for (unsigned int j = 0; j < pens.size(); j++) {
+        pens[j].reserve(pens[j].size() + count);
+    }
+    for (int first = 0; first < count; first += RESEED_INTERVAL) {
+        double theta = reduce(start + first * step);
+        for (int i = 0; i < gearCount; i++) {
+            phasors[i] = phasor(distances[i], centreRates[i] * theta);
+        }
+        glm::dvec2 arm = phasor(1, penRate * theta);
+
+        int end = first + RESEED_INTERVAL < count ? first + RESEED_INTERVAL : count;
+        for (int point = first; point < end; point++) {
+            // the centre of the last gear, shared by all pens
+            glm::dvec2 centre(0, 0);
+            for (int i = 0; i < gearCount; i++) {
+                centre = centre + phasors[i];
+                phasors[i] = multiply(phasors[i], factors[i]);
+            }
+            for (unsigned int j = 0; j < pens.size(); j++) {
+                glm::dvec2 pen = centre + penOffsets[j] * arm;
+                pens[j].push_back(glm::vec4(pen.x, pen.y, 0.0f, 1.0f));
+            }
+            arm = multiply(arm, penFactor);
+        }
+    }
+}
+
+// As sample over the period, but the phase of every phasor at point i is
+// i periodTurns_k / (count - 1) whole turns, worked out in whole numbers
+// and reduced to less than a turn before it becomes an angle. The points
+// between two exact ones come from the recurrence as in sample, so the
+// last point lands on the first to within rounding of a few multiplies.
+bool GearTrain::samplePeriod(int count, double maxAngle, const vector<double>& penOffsets,
+                             vector<vector<glm::vec4> >& pens) const {
+    if (periodMultiple == 0 || count < 2 || 2 * M_PI * periodMultiple / periodDivisor > maxAngle) {
+        return false;
+    }
+    long long intervals = count - 1;
+    for (int i = 0; i <= gearCount; i++) {
+        if (llabs(periodTurns[i]) > LLONG_MAX / intervals) {
+            return false;
+        }
+    }
+    glm::dvec2 phasors[MAX_GEARS];
+    glm::dvec2 factors[MAX_GEARS + 1];
+    for (int i = 0; i <= gearCount; i++) {
+        factors[i] = phasor(1, 2 * M_PI * (double) (periodTurns[i] % intervals) / intervals);
+    }
+
+    for (unsigned int j = 0; j < pens.size(); j++) {
+        pens[j].reserve(pens[j].size() + count);
+    }
+    for (int first = 0; first < count; first += RESEED_INTERVAL) {
+        // whole turns drop out of the product before it is divided
+        for (int i = 0; i < gearCount; i++) {
+            long long turns = periodTurns[i] * first % intervals;
+            phasors[i] = phasor(distances[i], 2 * M_PI * (double) turns / intervals);
+        }
+        long long penTurns = periodTurns[gearCount] * first % intervals;
+        glm::dvec2 arm = phasor(1, 2 * M_PI * (double) penTurns / intervals);
+
+        int end = first + RESEED_INTERVAL < count ? first + RESEED_INTERVAL : count;
+        for (int point = first; point < end; point++) {
+            glm::dvec2 centre(0, 0);
+            for (int i = 0; i < gearCount; i++) {
+                centre = centre + phasors[i];
+                phasors[i] = multiply(phasors[i], factors[i]);
+            }
+            for (unsigned int j = 0; j < pens.size(); j++) {
+                glm::dvec2 pen = centre + penOffsets[j] * arm;
+                pens[j].push_back(glm::vec4(pen.x, pen.y, 0.0f, 1.0f));
+            }
+            arm = multiply(arm, factors[gearCount]);
+        }
+    }
+    return true;
+}
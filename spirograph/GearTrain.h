@@ -0,0 +1,87 @@
+#ifndef __GEARTRAIN_H__
+#define __GEARTRAIN_H__
+
+#include <vector>
+#include <glm/glm.hpp>
+using namespace std;
+
+// Header for GearTrain of Spirograph program.
+// A fixed ring with a chain of gears rolling on it, each inside or around
+// the outside of the one before, and pens on the last gear. The centre of
+// every gear turns around the one before at a constant rate, so a pen is
+// a sum of phasors
+//   p(theta) = sum_k a_k e^(i w_k theta) + d e^(i v theta)
+// whose frequencies follow from the radii. Sampling at a fixed step turns
+// each phasor by the same factor from one point to the next, so a point
+// costs one complex multiply per gear. With whole radii the frequencies
+// are fractions, kept exactly, so the phases over a whole period are
+// worked out in whole numbers and the curve closes to the last bit; angles
+// beyond the period are brought back within it before any sin or cos.
+// Everything is held in fixed-size arrays, so a train can be copied around
+// without allocating.
+
+#define MAX_GEARS 8 // rolling gears in a train
+
+// One gear of a train.
+struct Gear {
+    int radius;
+    bool outside; // rolls around the outside of the gear before it
+
+    bool operator<(const Gear& other) const;
+    bool operator==(const Gear& other) const;
+};
+
+class GearTrain
+{
+public:
+    GearTrain();
+    GearTrain(int ringRadius, const Gear *gears, int gearCount); // at least one gear
+
+    int getRingRadius() const;
+    int getGearCount() const;
+    const Gear& getGear(int i) const;
+    bool operator==(const GearTrain& other) const; // the same ring and gears
+
+    // Angle theta of the first gear's centre after which every gear is back
+    // where it started, so the pattern is closed; maxAngle if that is further
+    // (or the radii make it too long to work out).
+    double getPeriod(double maxAngle) const;
+
+    // centre and rotation of every gear when the first has travelled theta
+    void getPose(double theta, glm::vec2 *centres, float *rotations) const;
+
+    // largest number of turns any gear or centre makes per turn of theta
+    double getFastestRate() const;
+
+    // appends points at theta = start, start + step, ..., start + (count - 1) step
+    // to one line strip per pen, the pens penOffsets[i] from the centre of the last gear
+    void sample(int count, double step, const vector<double>& penOffsets,
+                vector<vector<glm::vec4> >& pens, double start = 0) const;
+
+    // appends count points spread evenly over the period, the last exactly
+    // on the first, if the period is no longer than maxAngle; false otherwise
+    bool samplePeriod(int count, double maxAngle, const vector<double>& penOffsets,
+                      vector<vector<glm::vec4> >& pens) const;
+
+    // position of a pen penOffset from the centre of the last gear, all in double
+    glm::dvec2 getPenPosition(double theta, double penOffset) const;
+
+private:
+    int ringRadius; // radius of the fixed ring the first gear rolls on
+    int gearCount;
+    Gear gears[MAX_GEARS];
+    double distances[MAX_GEARS]; // from the centre of the gear before (the ring for the first)
+    double centreRates[MAX_GEARS]; // turns of each centre around the one before, per turn of theta
+    double rotationRates[MAX_GEARS]; // turns of each gear, per turn of theta
+
+    // The period is 2 pi periodMultiple / periodDivisor, over which the
+    // centres and then the pens make periodTurns whole turns; periodMultiple
+    // is 0 when the fractions grow too large to work with.
+    long long periodMultiple;
+    long long periodDivisor;
+    long long periodTurns[MAX_GEARS + 1];
+
+    double reduce(double theta) const; // theta less whole periods
+};
+
+#endif
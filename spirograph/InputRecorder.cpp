@@ -0,0 +1,145 @@
+#include "InputRecorder.h"
+#include <cstring>
+#include <cstddef>
+#include "spdlog/spdlog.h"
+
+// Implementation of InputRecorder of Program.
+
+static const char MAGIC[4] = {'S', 'P', 'I', 'N'};
+static const uint32_t VERSION = 2;
+
+InputRecorder::InputRecorder() {
+    out = NULL;
+    next = 0;
+    sessionFrames = 0;
+    replaying = false;
+}
+
+InputRecorder::~InputRecorder() {
+    if (out != NULL) {
+        fclose(out);
+    }
+}
+
+// records events from now on
+bool InputRecorder::startRecording(const string& file) {
+    out = fopen(file.c_str(), "wb");
+    if (out == NULL) {
+        spdlog::error("Could not open {} to record input", file);
+        return false;
+    }
+    fwrite(MAGIC, 1, sizeof(MAGIC), out);
+    fwrite(&VERSION, sizeof(VERSION), 1, out);
+    spdlog::info("Recording input to {}", file);
+    return true;
+}
+
+// loads all events of a recording
+bool InputRecorder::startReplay(const string& file) {
+    FILE *in = fopen(file.c_str(), "rb");
+    if (in == NULL) {
+        spdlog::error("Could not open {} to replay input", file);
+        return false;
+    }
+    char magic[4];
+    uint32_t version = 0;
+    if (fread(magic, 1, sizeof(magic), in) != sizeof(magic) || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0
+        || fread(&version, sizeof(version), 1, in) != 1 || version < 1 || version > VERSION) {
+        spdlog::error("{} is not an input recording", file);
+        fclose(in);
+        return false;
+    }
+    // events of version 1 end before the scroll fields
+    size_t eventSize = version == 1 ? offsetof(InputEvent, scrollOffset) : sizeof(InputEvent);
+    InputEvent event;
+    memset(&event, 0, sizeof(event));
+    while (fread(&event, eventSize, 1, in) == 1) {
+        if (event.key == END_OF_SESSION) {
+            sessionFrames = event.frame;
+            break;
+        }
+        events.push_back(event);
+    }
+    fclose(in);
+    if (sessionFrames == 0) {
+        // recording was cut short, end after the last event
+        sessionFrames = events.empty() ? 0 : events.back().frame + 1;
+    }
+    next = 0;
+    replaying = true;
+    spdlog::info("Replaying {} input events over {} frames from {}", events.size(), sessionFrames, file);
+    return true;
+}
+
+// true if recording
+bool InputRecorder::isRecording() {
+    return out != NULL;
+}
+
+// true if replaying
+bool InputRecorder::isReplaying() {
+    return replaying;
+}
+
+// records a key event, arriving after frame frames were drawn
+void InputRecorder::record(unsigned long frame, double time, int key, int scancode, int action, int mods) {
+    if (out == NULL) {
+        return;
+    }
+    InputEvent event;
+    event.frame = frame;
+    event.time = time;
+    event.key = key;
+    event.scancode = scancode;
+    event.action = action;
+    event.mods = mods;
+    event.padding = 0;
+    event.scrollOffset = 0;
+    event.cursorX = 0;
+    event.cursorY = 0;
+    fwrite(&event, sizeof(event), 1, out);
+}
+
+// records a scroll of offset steps with the cursor at (x, y), as fractions of the window
+void InputRecorder::recordScroll(unsigned long frame, double time, double offset, double x, double y) {
+    if (out == NULL) {
+        return;
+    }
+    InputEvent event;
+    memset(&event, 0, sizeof(event));
+    event.frame = frame;
+    event.time = time;
+    event.key = SCROLL;
+    event.scrollOffset = offset;
+    event.cursorX = x;
+    event.cursorY = y;
+    fwrite(&event, sizeof(event), 1, out);
+}
+
+// next replayed event for the given frame, false when there is none left
+bool InputRecorder::nextEvent(unsigned long frame, InputEvent& event) {
+    if (!replaying || next >= events.size() || events[next].frame > frame) {
+        return false;
+    }
+    event = events[next++];
+    return true;
+}
+
+// frames in the replayed session
+unsigned long InputRecorder::getSessionFrames() {
+    return sessionFrames;
+}
+
+// ends recording after frame frames
+void InputRecorder::finish(unsigned long frame) {
+    if (out == NULL) {
+        return;
+    }
+    InputEvent end;
+    memset(&end, 0, sizeof(end));
+    end.frame = frame;
+    end.key = END_OF_SESSION;
+    fwrite(&end, sizeof(end), 1, out);
+    fclose(out);
+    out = NULL;
+}
@@ -0,0 +1,61 @@
+#ifndef __INPUTRECORDER_H__
+#define __INPUTRECORDER_H__
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Header for InputRecorder of Spirograph program.
+// Records key and scroll events with the frame they arrived in to a binary
+// file, and plays such a file back so that a session can be rerun identically.
+//
+// File layout: the 4 bytes "SPIN", a uint32 version, then one 28 byte
+// InputEvent per key or scroll event (16 bytes in version 1, which had no
+// scroll events). Recording ends with an event whose key is END_OF_SESSION,
+// stamped with the number of frames in the session.
+
+struct InputEvent {
+    uint32_t frame; // number of frames drawn before the event arrived
+    float time; // seconds since recording started, for reference only
+    int16_t key;
+    int16_t scancode;
+    uint8_t action;
+    uint8_t mods;
+    uint16_t padding;
+    float scrollOffset; // steps scrolled, for SCROLL events
+    float cursorX, cursorY; // cursor position as a fraction of the window, for SCROLL events
+};
+
+class InputRecorder
+{
+public:
+    // key of the last event in a file, below every GLFW key (unknown keys are -1)
+    static const int16_t END_OF_SESSION = INT16_MIN;
+    static const int16_t SCROLL = INT16_MIN + 1; // key of a scroll event
+
+    InputRecorder();
+    ~InputRecorder();
+    bool startRecording(const string& file); // records events from now on
+    bool startReplay(const string& file); // loads all events of a recording
+    bool isRecording(); // true if recording
+    bool isReplaying(); // true if replaying
+    // records a key event, arriving after frame frames were drawn
+    void record(unsigned long frame, double time, int key, int scancode, int action, int mods);
+    // records a scroll of offset steps with the cursor at (x, y), as fractions of the window
+    void recordScroll(unsigned long frame, double time, double offset, double x, double y);
+    // next replayed event for the given frame, false when there is none left
+    bool nextEvent(unsigned long frame, InputEvent& event);
+    unsigned long getSessionFrames(); // frames in the replayed session
+    void finish(unsigned long frame); // ends recording after frame frames
+
+private:
+    FILE *out; // file being recorded, NULL if not recording
+    vector<InputEvent> events; // replayed events in frame order
+    unsigned int next; // index of the next event to replay
+    unsigned long sessionFrames; // frames in the replayed session
+    bool replaying; // true if replaying
+};
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef __LRUCACHE_H__
+#define __LRUCACHE_H__
+
+#include <list>
+#include <map>
+#include <cstddef>
+using namespace std;
+
+// Header for LruCache of Spirograph program.
+// Keeps values up to a total size in bytes (as given when they are put in),
+// dropping the least recently used ones to make room for new ones. Counts
+// hits, misses and evictions so that the cache can be tuned. Not thread
+// safe: every call must come from the same thread or be locked by the caller.
+// Values are copied in and out, so large values are best held by shared_ptr.
+
+template <class Key, class Value>
+class LruCache
+{
+public:
+    LruCache(size_t capacity) : capacity(capacity), bytes(0), hits(0), misses(0), evictions(0) {}
+
+    // copies the value of key and makes it the most recently used,
+    // false (and a miss) if it is not cached
+    bool get(const Key& key, Value& value) {
+        typename map<Key, typename list<Entry>::iterator>::iterator it = index.find(key);
+        if (it == index.end()) {
+            misses++;
+            return false;
+        }
+        hits++;
+        entries.splice(entries.begin(), entries, it->second);
+        value = it->second->value;
+        return true;
+    }
+
+    // true if key is cached, without counting or reordering anything
+    bool contains(const Key& key) const {
+        return index.count(key) != 0;
+    }
+
+    // caches value under key as the most recently used, evicting the least
+    // recently used entries to make room; values larger than the whole cache are not kept
+    void put(const Key& key, const Value& value, size_t size) {
+        erase(key);
+        if (size > capacity) {
+            return;
+        }
+        while (bytes + size > capacity && !entries.empty()) {
+            evictions++;
+            erase(entries.back().key);
+        }
+        Entry entry;
+        entry.key = key;
+        entry.value = value;
+        entry.size = size;
+        entries.push_front(entry);
+        index[key] = entries.begin();
+        bytes = bytes + size;
+    }
+
+    // drops key if it is cached
+    void erase(const Key& key) {
+        typename map<Key, typename list<Entry>::iterator>::iterator it = index.find(key);
+        if (it == index.end()) {
+            return;
+        }
+        bytes = bytes - it->second->size;
+        entries.erase(it->second);
+        index.erase(it);
+    }
+
+    // drops everything, the counters are kept
+    void clear() {
+        entries.clear();
+        index.clear();
+        bytes = 0;
+    }
+
+    size_t getBytes() const { return bytes; } // size of all cached values
+    size_t getCapacity() const { return capacity; }
+    size_t getEntryCount() const { return entries.size(); }
+    unsigned long getHits() const { return hits; }
+    unsigned long getMisses() const { return misses; }
+    unsigned long getEvictions() const { return evictions; }
+
+private:
+    struct Entry {
+        Key key;
+        Value value;
+        size_t size; // bytes counted for the value
+    };
+
+    list<Entry> entries; // most recently used first
+    map<Key, typename list<Entry>::iterator> index; // entry of each key
+    size_t capacity; // largest total size in bytes
+    size_t bytes; // total size of the cached values
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+};
+
+#endif
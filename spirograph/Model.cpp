@@ -5,19 +5,54 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <math.h>
 #include "spdlog/spdlog.h"
+#include "StartupProfiler.h"
+#include "Trace.h"
+#include "AllocationTracker.h"
+#include "ArcLengthTable.h"
+#include "CompensatedSum.h"
+#include "ShapeRoller.h"
+#include <thread>
+#include <tuple>
 
 // Implementation of Model of Program.
 
+// orders keys field by field, for the curve cache
+bool CurveKey::operator<(const CurveKey& other) const {
+    return tie(bigRadius, smallRadius, penOffsets, tolerance, arcLengthPoints, levelCount, symmetryInstancing,
+               outsideRolling, nestedGears, fourierCurve, ringShape, gearShape)
+        < tie(other.bigRadius, other.smallRadius, other.penOffsets, other.tolerance,
+              other.arcLengthPoints, other.levelCount, other.symmetryInstancing,
+              other.outsideRolling, other.nestedGears, other.fourierCurve,
+              other.ringShape, other.gearShape);
+}
+
+bool CurveKey::operator==(const CurveKey& other) const {
+    return !(*this < other) && !(other < *this);
+}
+
 // constructor of model sets up inner and outer circles.
-Model::Model()
+Model::Model() : curveCache(CURVE_CACHE_BYTES)
 {
     bigCircRadius = 400;
     smallCircRadius = 200;
     smallCircPosX = bigCircRadius - smallCircRadius;
     smallCircPosY = 0;
     twicePi = 2 * M_PI;
-    makeCircleMesh();
-    makeDrawingCurveMesh();
+    curveTolerance = 0;
+    arcLengthPoints = 0;
+    curveLevelCount = 1;
+    symmetryInstancing = false;
+    outsideRolling = false;
+    samplingThreads = 1;
+    penOffsets.push_back(0.5); // one pen halfway out
+    {
+        StartupSpan span("makeCircleMesh");
+        makeCircleMesh();
+    }
+    {
+        StartupSpan span("makeDrawingCurveMesh");
+        makeDrawingCurveMesh();
+    }
     //genSmallCircVertexData();
     //genBigCircVertexData();
 }
@@ -54,68 +89,535 @@ void Model::makeCircleMesh() {
     circleMesh.push_back(mesh);
 }
 
+// speed of a pen penOffset from the centre of an inner circle that is
+// distance from the origin and turns lambda times as fast as it travels,
+// where cosine = cos((lambda - 1) theta):
+// |i a e^(i theta) + i lambda d e^(i lambda theta)|
+static double rollingSpeed(double distance, double lambda, double penOffset, double cosine) {
+    double speed2 = distance * distance + lambda * lambda * penOffset * penOffset
+        + 2 * distance * lambda * penOffset * cosine;
+    return sqrt(max(speed2, 0.0));
+}
+
 // creates mesh for the curve
 void Model::makeDrawingCurveMesh() {
+    TRACE_SCOPE("Model::makeDrawingCurveMesh");
+    ALLOC_PHASE("curve generation");
+    // every pen is sampled in the same pass, sharing the inner circle's path
+    vector<vector<glm::vec4> > pens(penOffsets.size());
+    if (fourierCurve) {
+        // a Fourier curve has no pens, it is the one line strip
+        pens.resize(1);
+        sampleFourier(pens[0]);
+    }
+    else if (isShapeMode()) {
+        sampleShapes(pens);
+    }
+    else if (!nestedGears.empty()) {
+        sampleGearTrain(pens);
+    }
+    else if (arcLengthPoints > 1) {
+        sampleUniformArcLength(pens);
+    }
+    else if (curveTolerance > 0) {
+        sampleAdaptive(pens);
+    }
+    else {
+        sampleFixedStep(pens);
+    }
+
+    // the pens one after another, each followed by its coarser levels of detail
     vector<glm::vec4> positions;
+    positions.swap(pens[0]);
+    curveLevels.clear();
+    makeCurveLevels(positions, 0);
+    for (unsigned int i = 1; i < pens.size(); i++) {
+        int first = positions.size();
+        positions.insert(positions.end(), pens[i].begin(), pens[i].end());
+        makeCurveLevels(positions, first);
+    }
 
+    util::PolygonMesh<VertexAttrib> mesh = createMeshFromPositions(positions);
+    makeCurveChunks(mesh);
+    curveMesh.push_back(mesh);
+}
+
+// 20000 points a fixed arc step apart for every pen
+void Model::sampleFixedStep(vector<vector<glm::vec4> >& pens) {
     // radius = 400, circumfrence = 2800, step of 1 = 0.1°
     float step = 10; 
 
     // if angle is theta, then length of arc is r
     // if the arc is step, then angle will be step/r
-    float deltaTheta1 = 1.0f *  step / bigCircRadius;
-    float deltaTheta2 = - 1.0f * step / smallCircRadius;
+    double deltaTheta = 1.0 * step / bigCircRadius;
 
-    // Initial center of inner circle
-    float x = bigCircRadius - smallCircRadius;
-    glm::vec4 cp(x,0.0f,0.0f,1.0f);
+    // one lobe ends exactly where the next one starts
+    int pointCount = 20000;
+    if (symmetryInstancing) {
+        pointCount = (int) ceil(curveEnd() / deltaTheta);
+    }
 
-    // Initial location of seed point in inner circle
-    float s = bigCircRadius - smallCircRadius/2;
-    glm::vec4 sp(s,0.0f,0.0f,1.0f);
+    for (unsigned int i = 0; i < pens.size(); i++) {
+        pens[i].reserve(pointCount + 1);
+    }
+    // a train of one gear, turning phasors instead of evaluating the carrier every step
+    vector<double> distances(pens.size());
+    for (unsigned int i = 0; i < pens.size(); i++) {
+        distances[i] = getPenOffset(i);
+    }
+    getGearTrain().sample(pointCount, deltaTheta, distances, pens);
+    if (symmetryInstancing) {
+        addPenPositions(curveEnd(), pens);
+    }
+}
 
-    // first rotation matrix
-    glm::mat4 r1 = glm::rotate(glm::mat4(1.0f), deltaTheta1, glm::vec3(0.0, 0.0, 1.0));
-    
-    int points = 0;
-    while(points < 20000) {
-        positions.push_back(sp);
-        sp = doubleRotate(cp,sp,deltaTheta1,deltaTheta2);
-        cp = r1 * cp;
-        points = points + 1;
+// GEAR_TRAIN_POINTS points a fixed step apart over the period of a train
+// of several gears, for every pen (the tolerance, arc-length and symmetry
+// settings only apply to a single gear); phases worked out exactly when
+// the train closes within MAX_GEAR_TRAIN_ANGLE
+void Model::sampleGearTrain(vector<vector<glm::vec4> >& pens) {
+    GearTrain train = getGearTrain();
+    vector<double> distances(pens.size());
+    for (unsigned int i = 0; i < pens.size(); i++) {
+        distances[i] = getPenOffset(i);
+    }
+    // the exact phases may overflow even when the period is short enough to
+    // draw, which is then sampled step by step as before
+    if (!train.samplePeriod(GEAR_TRAIN_POINTS, MAX_GEAR_TRAIN_ANGLE, distances, pens)) {
+        train.sample(GEAR_TRAIN_POINTS, train.getPeriod(MAX_GEAR_TRAIN_ANGLE) / (GEAR_TRAIN_POINTS - 1), distances, pens);
     }
+}
 
-    util::PolygonMesh<VertexAttrib> mesh = createMeshFromPositions(positions);
-    curveMesh.push_back(mesh);
+// the Fourier curve at FOURIER_POINTS points, or arcLengthPoints when set
+// (rounded up to a power of two), evenly spaced in its parameter
+void Model::sampleFourier(vector<glm::vec4>& positions) {
+    fourierCurve->sample(arcLengthPoints > 1 ? arcLengthPoints : FOURIER_POINTS, positions);
+}
+
+// SHAPE_POINTS points, or arcLengthPoints when set, evenly spaced along the
+// ring until the gear is back where it started, for every pen; the points
+// are worked out on samplingThreads threads (a round ring or gear is a fine polyline)
+void Model::sampleShapes(vector<vector<glm::vec4> >& pens) {
+    Shape ring = ringShape ? *ringShape : Shape::ellipse(bigCircRadius, bigCircRadius, SHAPE_CIRCLE_POINTS);
+    Shape gear = gearShape ? *gearShape : Shape::ellipse(smallCircRadius, smallCircRadius, SHAPE_CIRCLE_POINTS);
+    ShapeRoller roller(ring, gear, outsideRolling);
+    vector<double> distances(pens.size());
+    for (unsigned int i = 0; i < pens.size(); i++) {
+        distances[i] = getPenOffset(i);
+    }
+    roller.sample(arcLengthPoints > 1 ? arcLengthPoints : SHAPE_POINTS, roller.getEnd(), distances, pens, samplingThreads);
+}
+
+// last angle of the inner circle centre the curve is made for: the end of
+// the first lobe when instancing, otherwise the last of 20000 fixed steps
+double Model::curveEnd() {
+    if (symmetryInstancing) {
+        return getLobeAngle();
+    }
+    return 19999 * 10.0 / bigCircRadius;
+}
+
+// Points spaced by the curvature so that no chord strays further than
+// curveTolerance from the curve, over the same stretch of curve as
+// sampleFixedStep. The pen is at
+//   p(theta) = (R - r) e^(i theta) + d e^(i lambda theta),  lambda = 1 - R/r
+// (R + r and 1 + R/r for an inner circle rolling around the outside)
+// and a chord of length L across a stretch of curvature k is off the
+// curve by about k L^2 / 8, so each step is as long as that allows.
+// All pens share the steps, taking the shortest any of them needs.
+void Model::sampleAdaptive(vector<vector<glm::vec4> >& pens) {
+    double lambda = rollRate();
+    double end = curveEnd();
+
+    // no step turns either circle by more than a sixth of a turn,
+    // so a loop cannot be skipped between two points of low curvature
+    double maxStep = (M_PI / 3) / max(1.0, fabs(lambda));
+
+    for (unsigned int i = 0; i < pens.size(); i++) {
+        pens[i].reserve(4096);
+    }
+    // thousands of uneven steps, summed without losing their rounding errors
+    CompensatedSum theta;
+    while (theta.get() < end) {
+        addPenPositions(theta.get(), pens);
+        // the curvature can rise within the step, so its middle and end have a say too
+        double step = adaptiveStep(theta.get(), maxStep);
+        step = min(step, adaptiveStep(theta.get() + step / 2, maxStep));
+        step = min(step, adaptiveStep(theta.get() + step, maxStep));
+        theta.add(step);
+    }
+    addPenPositions(end, pens);
+}
+
+// angle step at theta that keeps the chord error of every pen within curveTolerance
+double Model::adaptiveStep(double theta, double maxStep) {
+    double distance = rollingDistance();
+    double lambda = rollRate();
+    double roll = lambda * theta;
+    double sine = sin(theta);
+    double cosine = cos(theta);
+    double rollSine = sin(roll);
+    double rollCosine = cos(roll);
+
+    double step = maxStep;
+    for (unsigned int i = 0; i < penOffsets.size(); i++) {
+        double penOffset = getPenOffset(i);
+        // first and second derivatives of the pen position by theta
+        double dx = -distance * sine - lambda * penOffset * rollSine;
+        double dy = distance * cosine + lambda * penOffset * rollCosine;
+        double ddx = -distance * cosine - lambda * lambda * penOffset * rollCosine;
+        double ddy = -distance * sine - lambda * lambda * penOffset * rollSine;
+
+        double speed = sqrt(dx * dx + dy * dy);
+        if (speed < 1e-9) {
+            step = min(step, maxStep / 1024);
+            continue;
+        }
+        double curvature = fabs(dx * ddy - dy * ddx) / (speed * speed * speed);
+        if (curvature < 1e-12) {
+            continue;
+        }
+        step = min(step, max(sqrt(8 * curveTolerance / curvature) / speed, maxStep / 1024));
+    }
+    return step;
+}
+
+// arcLengthPoints points evenly spaced along the same stretch of curve as
+// sampleFixedStep, for every pen. A cumulative arc-length table over a
+// fine grid of angles gives, by binary search, the grid cell holding each
+// target length; linear interpolation in the cell is then refined with
+// Newton steps on the exact arc length, whose derivative is the pen speed.
+// The pens have tables of their own over the same grid.
+void Model::sampleUniformArcLength(vector<vector<glm::vec4> >& pens) {
+    double distance = rollingDistance();
+    double lambda = rollRate();
+    double end = curveEnd();
+    // a lobe gets its share of the points of the whole pattern
+    int points = max(arcLengthPoints / getLobeCount() + 1, 2);
+
+    // at least as fine as the output and a few cells per sixth of a turn of either circle
+    double cell = min(end / points, (M_PI / 12) / max(1.0, fabs(lambda)));
+    int cells = (int) ceil(end / cell);
+    cell = end / cells;
+
+    int penCount = pens.size();
+    vector<ArcLengthTable> tables(penCount);
+    vector<double> startSpeeds(penCount);
+    for (int i = 0; i < penCount; i++) {
+        tables[i].reserve(cells + 1);
+        tables[i].add(0, 0);
+        startSpeeds[i] = penSpeed(0, getPenOffset(i));
+    }
+    // Simpson's rule per cell, sharing the speed at the cell ends;
+    // the cosine all pen speeds depend on is worked out once per angle
+    for (int i = 1; i <= cells; i++) {
+        double middleCosine = cos((lambda - 1) * (i - 0.5) * cell);
+        double endCosine = cos((lambda - 1) * i * cell);
+        for (int j = 0; j < penCount; j++) {
+            double penOffset = getPenOffset(j);
+            double endSpeed = rollingSpeed(distance, lambda, penOffset, endCosine);
+            double middleSpeed = rollingSpeed(distance, lambda, penOffset, middleCosine);
+            tables[j].add(i * cell, cell / 6 * (startSpeeds[j] + 4 * middleSpeed + endSpeed));
+            startSpeeds[j] = endSpeed;
+        }
+    }
+
+    for (int j = 0; j < penCount; j++) {
+        const ArcLengthTable& table = tables[j];
+        double penOffset = getPenOffset(j);
+        double spacing = table.getLength() / (points - 1);
+        pens[j].reserve(points);
+        int segment = 0;
+        for (int i = 0; i < points; i++) {
+            double s = i * spacing;
+            // targets only increase, so the search can start at the last segment
+            segment = table.findSegment(s, segment);
+            double theta1 = table.getParameter(segment);
+            double theta2 = table.getParameter(segment + 1);
+            double length1 = table.getArcLength(segment);
+            double length2 = table.getArcLength(segment + 1);
+            double theta = theta1 + (theta2 - theta1) * (s - length1) / (length2 - length1);
+            // the cells are small, so one Newton step from there is already well below a micro-unit
+            double speed = penSpeed(theta, penOffset);
+            if (speed > 1e-9) {
+                theta = theta - (length1 + arcLength(theta1, theta, penOffset) - s) / speed;
+                theta = min(max(theta, theta1), theta2);
+            }
+            pens[j].push_back(penPosition(theta, penOffset));
+        }
+    }
+}
+
+// inner circle centre when it has travelled angle theta, and the unit
+// vector from there that it has turned the pens to
+void Model::carrier(double theta, glm::dvec2& centre, glm::dvec2& arm) {
+    double distance = rollingDistance();
+    double roll = rollRate() * theta;
+    centre = glm::dvec2(distance * cos(theta), distance * sin(theta));
+    arm = glm::dvec2(cos(roll), sin(roll));
+}
+
+// appends the position of every pen at theta, working out the carrier once for all of them
+void Model::addPenPositions(double theta, vector<vector<glm::vec4> >& pens) {
+    glm::dvec2 centre, arm;
+    carrier(theta, centre, arm);
+    for (unsigned int i = 0; i < pens.size(); i++) {
+        glm::dvec2 pen = centre + getPenOffset(i) * arm;
+        pens[i].push_back(glm::vec4(pen.x, pen.y, 0.0f, 1.0f));
+    }
+}
+
+// position of a pen penOffset from the inner circle centre when the centre has travelled angle theta
+glm::vec4 Model::penPosition(double theta, double penOffset) {
+    glm::dvec2 centre, arm;
+    carrier(theta, centre, arm);
+    glm::dvec2 pen = centre + penOffset * arm;
+    return glm::vec4(pen.x, pen.y, 0.0f, 1.0f);
+}
+
+// length of the derivative of penPosition by theta
+double Model::penSpeed(double theta, double penOffset) {
+    double distance = rollingDistance();
+    double lambda = rollRate();
+    return rollingSpeed(distance, lambda, penOffset, cos((lambda - 1) * theta));
+}
+
+// length of the curve of a pen between two angles, by Simpson's rule
+double Model::arcLength(double theta1, double theta2, double penOffset) {
+    return (theta2 - theta1) / 6
+        * (penSpeed(theta1, penOffset) + 4 * penSpeed((theta1 + theta2) / 2, penOffset)
+           + penSpeed(theta2, penOffset));
+}
+
+// distances of the pens from the inner circle centre, as fractions of its
+// radius; every pen draws a curve of its own
+void Model::setPenOffsets(const vector<double>& offsets) {
+    penOffsets.assign(offsets.begin(), offsets.begin() + min((int) offsets.size(), MAX_PENS));
+    if (penOffsets.empty()) {
+        penOffsets.push_back(0.5);
+    }
+}
+
+// distances of the pens from the inner circle centre, as fractions of its radius
+vector<double> Model::getPenOffsets() {
+    return penOffsets;
 }
 
-// finds seed position based on seed and inner circle position and angles provided
-// cp = inner circle centre
-// sp = seed point position 
-glm::vec4 Model::doubleRotate(glm::vec4 cp, glm::vec4 sp, float deltaTheta1, float deltaTheta2) {
-    // first rotation
-    glm::mat4 r1 = glm::rotate(glm::mat4(1.0f),deltaTheta1, glm::vec3(0.0, 0.0, 1.0));
-    cp = r1*cp;
-    sp = r1*sp;
+int Model::getPenCount() {
+    return penOffsets.size();
+}
+
+// distance of a pen from the inner circle centre in model units
+double Model::getPenOffset(int pen) {
+    if (isShapeMode()) {
+        return penOffsets[pen] * (gearShape ? gearShape->getReach() : smallCircRadius);
+    }
+    int radius = nestedGears.empty() ? smallCircRadius : nestedGears.back().radius;
+    return penOffsets[pen] * radius;
+}
+
+// makes the inner circle roll around the outside of the outer one (an epitrochoid)
+void Model::setOutsideRolling(bool on) {
+    outsideRolling = on;
+}
+
+bool Model::isOutsideRolling() {
+    return outsideRolling;
+}
+
+// gears rolling on the inner circle and on each other, the pens on the last
+void Model::setNestedGears(const vector<Gear>& gears) {
+    nestedGears.assign(gears.begin(), gears.begin() + min((int) gears.size(), MAX_GEARS - 1));
+}
 
-    // Translate cp and sp that cp is at origin
-    float dx = cp.x; // inner circle current posX
-    float dy = cp.y; // inner circle current posY
-    glm::mat4 t1 = glm::translate(glm::mat4(1.0),glm::vec3(-dx, -dy, 0)); // move to center
-    cp = t1*cp; // this should be at 0,0
-    sp = t1*sp; // will move relative to inner circle
+// the outer circle, the inner circle and the nested gears as one train
+GearTrain Model::getGearTrain() {
+    Gear gears[MAX_GEARS];
+    gears[0].radius = smallCircRadius;
+    gears[0].outside = outsideRolling;
+    for (unsigned int i = 0; i < nestedGears.size(); i++) {
+        gears[i + 1] = nestedGears[i];
+    }
+    return GearTrain(bigCircRadius, gears, nestedGears.size() + 1);
+}
 
-    // second rotation
-    glm::mat4 r2 = glm::rotate(glm::mat4(1.0f),deltaTheta2, glm::vec3(0.0, 0.0, 1.0));
-    cp = r2*cp; // cp is already at 0,0 so nothing should happen here
-    sp = r2*sp; // seed point will move
+// draws this Fourier series instead of the circles' curve, NULL to go back
+void Model::setFourierCurve(const shared_ptr<const FourierCurve>& curve) {
+    fourierCurve = curve;
+}
 
-    // translate inner circle back up to position
-    glm::mat4 t2 = glm::translate(glm::mat4(1.0),glm::vec3(dx, dy, 0));
-    cp = t2*cp; 
-    sp = t2*sp; 
+bool Model::isFourierMode() {
+    return fourierCurve != NULL;
+}
+
+// rolls on this outline instead of the outer circle, NULL to go back
+void Model::setRingShape(const shared_ptr<const Shape>& shape) {
+    ringShape = shape;
+}
+
+// rolls this outline instead of the inner circle, NULL to go back
+void Model::setGearShape(const shared_ptr<const Shape>& shape) {
+    gearShape = shape;
+}
 
-    return sp;
+bool Model::isShapeMode() {
+    return ringShape || gearShape;
+}
+
+// threads the curve of shaped gears is sampled on
+void Model::setSamplingThreads(int threads) {
+    samplingThreads = max(threads, 1);
+}
+
+// distance between the centres of the circles
+double Model::rollingDistance() {
+    return outsideRolling ? bigCircRadius + smallCircRadius : bigCircRadius - smallCircRadius;
+}
+
+// turns of the inner circle per turn of its centre around the outer one
+double Model::rollRate() {
+    double ratio = (double) bigCircRadius / smallCircRadius;
+    return outsideRolling ? 1.0 + ratio : 1.0 - ratio;
+}
+
+// respaces the curve to this many points evenly spread along its length
+void Model::setArcLengthPoints(int points) {
+    arcLengthPoints = points;
+}
+
+// Appends the coarser levels of detail to the finest one, which is
+// positions[first, end), so that all of them end up in one mesh. Each level keeps the points of the
+// one before that it needs to stay within a tolerance four times the
+// previous one. A point of the finer level is within the tolerance of the
+// coarser line strip, and so is every segment between such points, so the
+// errors of the levels add up to the error against the finest level.
+void Model::makeCurveLevels(vector<glm::vec4>& positions, int first) {
+    CurveLevel level;
+    level.first = first;
+    level.count = positions.size() - first;
+    level.error = 0;
+    curveLevels.push_back(level);
+
+    float tolerance = CURVE_LEVEL_TOLERANCE;
+    for (int i = 1; i < curveLevelCount; i++) {
+        CurveLevel coarser;
+        coarser.first = positions.size();
+        coarser.count = decimate(positions, level.first, level.count, tolerance);
+        coarser.error = level.error + tolerance;
+        curveLevels.push_back(coarser);
+        level = coarser;
+        tolerance = tolerance * 4;
+    }
+}
+
+// Appends the points of positions[first, first + count) that a line strip
+// within tolerance of all of them needs, returns how many were appended.
+// Greedy: a segment from the last kept point grows while every point it
+// skips stays within tolerance of it (looking at most MAX_SKIPPED ahead).
+int Model::decimate(vector<glm::vec4>& positions, int first, int count, float tolerance) {
+    const int MAX_SKIPPED = 256;
+    int end = first + count;
+    int appended = 0;
+    int anchor = first;
+    positions.reserve(positions.size() + count / 2 + 2);
+    positions.push_back(positions[anchor]);
+    appended++;
+    while (anchor < end - 1) {
+        int next = anchor + 1;
+        for (int candidate = anchor + 2; candidate < end && candidate - anchor <= MAX_SKIPPED; candidate++) {
+            glm::vec2 a(positions[anchor]);
+            glm::vec2 ab = glm::vec2(positions[candidate]) - a;
+            float length2 = glm::dot(ab, ab);
+            bool fits = true;
+            for (int i = anchor + 1; i < candidate && fits; i++) {
+                glm::vec2 ap = glm::vec2(positions[i]) - a;
+                float t = length2 > 0 ? glm::clamp(glm::dot(ap, ab) / length2, 0.0f, 1.0f) : 0.0f;
+                fits = glm::length(ap - t * ab) <= tolerance;
+            }
+            if (!fits) {
+                break;
+            }
+            next = candidate;
+        }
+        // positions may have been moved by the push_back, so copy through the index
+        glm::vec4 kept = positions[next];
+        positions.push_back(kept);
+        appended++;
+        anchor = next;
+    }
+    return appended;
+}
+
+// splits every level of the curve mesh into chunks of CURVE_CHUNK_SIZE
+// segments, with the bounding box of each
+void Model::makeCurveChunks(util::PolygonMesh<VertexAttrib>& mesh) {
+    curveChunks.clear();
+    curveChunks.reserve(mesh.getPrimitiveCount() / CURVE_CHUNK_SIZE + curveLevels.size());
+    for (unsigned int i = 0; i < curveLevels.size(); i++) {
+        CurveLevel& level = curveLevels[i];
+        level.firstChunk = curveChunks.size();
+        int end = level.first + level.count;
+        for (int first = level.first; first < end - 1; first += CURVE_CHUNK_SIZE) {
+            CurveChunk chunk;
+            chunk.first = first;
+            chunk.count = min(CURVE_CHUNK_SIZE + 1, end - first);
+            glm::vec4 minimum, maximum;
+            mesh.computeBoundingBox(chunk.first, chunk.count, minimum, maximum);
+            chunk.minimum = glm::vec2(minimum);
+            chunk.maximum = glm::vec2(maximum);
+            curveChunks.push_back(chunk);
+        }
+        level.chunkCount = curveChunks.size() - level.firstChunk;
+    }
+}
+
+// chunks of all levels of the curve mesh
+vector<CurveChunk> Model::getCurveChunks() {
+    return curveChunks;
+}
+
+// makes the curve mesh hold only the first lobe of the pattern
+void Model::setSymmetryInstancing(bool on) {
+    symmetryInstancing = on;
+}
+
+// copies of the curve mesh making up the pattern, 1 if not instancing
+// p(theta + T) = e^(iT) p(theta) needs T and (R/r) T to be whole turns
+// apart, so T = 2 pi (r/g) / (R/g) with g = gcd(R, r), and R/g copies
+// turned by T make up the closed pattern
+int Model::getLobeCount() {
+    if (!symmetryInstancing || !nestedGears.empty() || fourierCurve || isShapeMode()) {
+        return 1;
+    }
+    int a = bigCircRadius;
+    int b = smallCircRadius;
+    while (b != 0) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return bigCircRadius / a;
+}
+
+// rotation from one copy to the next
+double Model::getLobeAngle() {
+    return 2 * M_PI * smallCircRadius / bigCircRadius;
+}
+
+// number of levels of detail in the curve mesh
+void Model::setCurveLevelCount(int levels) {
+    curveLevelCount = max(levels, 1);
+}
+
+// levels of detail of the curve mesh
+vector<CurveLevel> Model::getCurveLevels() {
+    return curveLevels;
+}
+
+// largest distance allowed between the curve and the line strip drawn for it,
+// in model units; 0 goes back to sampling the curve at a fixed step
+void Model::setCurveTolerance(double tolerance) {
+    curveTolerance = tolerance;
 }
 
 // returns mesh for a circle
@@ -125,6 +627,97 @@ vector<util::PolygonMesh<VertexAttrib> > Model::getCircleMesh() {
     return circleMesh;
 }
 
+// the curve for the current parameters, from the curve cache when it was made before
+shared_ptr<const CurveData> Model::getCurve() {
+    CurveKey key = getCurveKey();
+    {
+        lock_guard<mutex> lock(curveCacheLock);
+        shared_ptr<const CurveData> cached;
+        if (curveCache.get(key, cached)) {
+            return cached;
+        }
+    }
+
+    // made outside of the lock, so that a prefetch never waits for it
+    shared_ptr<const CurveData> curve = makeCurve();
+    addCurve(curve);
+    return curve;
+}
+
+// makes the curve for the current parameters, bypassing the cache
+shared_ptr<CurveData> Model::makeCurve() {
+    shared_ptr<CurveData> curve = make_shared<CurveData>();
+    curve->key = getCurveKey();
+    curve->meshes = getCurveMesh();
+    curve->levels = curveLevels;
+    curve->chunks = curveChunks;
+    curve->lobeCount = getLobeCount();
+    curve->lobeAngle = getLobeAngle();
+    curve->penCount = curveLevels.size() / curveLevelCount; // a Fourier curve has one line strip
+    curve->bytes = sizeof(CurveData)
+        + curve->levels.size() * sizeof(CurveLevel)
+        + curve->chunks.size() * sizeof(CurveChunk);
+    for (unsigned int i = 0; i < curve->meshes.size(); i++) {
+        curve->bytes += curve->meshes[i].getVertexCount() * sizeof(VertexAttrib)
+            + curve->meshes[i].getPrimitiveCount() * sizeof(unsigned int);
+    }
+    return curve;
+}
+
+// true if the curve of key is cached, without counting a hit or a miss
+bool Model::hasCurve(const CurveKey& key) {
+    lock_guard<mutex> lock(curveCacheLock);
+    return curveCache.contains(key);
+}
+
+// caches a curve made elsewhere, such as by a model on another thread
+void Model::addCurve(const shared_ptr<const CurveData>& curve) {
+    lock_guard<mutex> lock(curveCacheLock);
+    curveCache.put(curve->key, curve, curve->bytes);
+}
+
+// parameters the next curve would be made for
+CurveKey Model::getCurveKey() {
+    CurveKey key;
+    key.bigRadius = bigCircRadius;
+    key.smallRadius = smallCircRadius;
+    key.penOffsets = penOffsets;
+    key.outsideRolling = outsideRolling;
+    key.nestedGears = nestedGears;
+    key.fourierCurve = fourierCurve;
+    key.ringShape = ringShape;
+    key.gearShape = gearShape;
+    key.tolerance = curveTolerance;
+    key.arcLengthPoints = arcLengthPoints;
+    key.levelCount = curveLevelCount;
+    key.symmetryInstancing = symmetryInstancing;
+    return key;
+}
+
+// takes on the parameters of key
+void Model::setCurveKey(const CurveKey& key) {
+    bigCircRadius = key.bigRadius;
+    smallCircRadius = key.smallRadius;
+    curveTolerance = key.tolerance;
+    arcLengthPoints = key.arcLengthPoints;
+    curveLevelCount = key.levelCount;
+    symmetryInstancing = key.symmetryInstancing;
+    penOffsets = key.penOffsets;
+    outsideRolling = key.outsideRolling;
+    nestedGears = key.nestedGears;
+    fourierCurve = key.fourierCurve;
+    ringShape = key.ringShape;
+    gearShape = key.gearShape;
+}
+
+// logs hits, misses and memory of the curve cache
+void Model::logCurveCacheStats() {
+    lock_guard<mutex> lock(curveCacheLock);
+    spdlog::info("Curve cache: {} hits, {} misses, {} evictions, {} curves in {:.1f} of {:.1f} MiB",
+        curveCache.getHits(), curveCache.getMisses(), curveCache.getEvictions(),
+        curveCache.getEntryCount(), curveCache.getBytes() / 1048576.0, curveCache.getCapacity() / 1048576.0);
+}
+
 // returns mesh for a circle
 vector<util::PolygonMesh<VertexAttrib> > Model::getCurveMesh() {
     curveMesh.pop_back();
@@ -156,16 +749,17 @@ float Model::calcDistance(float x1, float y1, float x2, float y2) {
 }
 
 // creates vertex data from positions vector given
-vector<VertexAttrib> Model::createVertexData(vector<glm::vec4> positions){
+vector<VertexAttrib> Model::createVertexData(const vector<glm::vec4>& positions){
     vector<VertexAttrib> vertexData;
+    vector<float> data(4);
+    vertexData.reserve(positions.size());
     for (unsigned int i=0;i<positions.size();i++) {
         VertexAttrib v;
-        vector<float> data;
 
-        data.push_back(positions[i].x);
-        data.push_back(positions[i].y);
-        data.push_back(positions[i].z);
-        data.push_back(positions[i].w);
+        data[0] = positions[i].x;
+        data[1] = positions[i].y;
+        data[2] = positions[i].z;
+        data[3] = positions[i].w;
         v.setData("position",data);
         vertexData.push_back(v);
     }
@@ -173,12 +767,14 @@ vector<VertexAttrib> Model::createVertexData(vector<glm::vec4> positions){
 }
 
 // creates mesh from positions vector given
-util::PolygonMesh<VertexAttrib> Model::createMeshFromPositions(vector<glm::vec4> positions) {
+util::PolygonMesh<VertexAttrib> Model::createMeshFromPositions(const vector<glm::vec4>& positions) {
+    ALLOC_PHASE("mesh packing");
     // get vertex data by passing in positions vector
     vector<VertexAttrib> vertexData = createVertexData(positions);
     
     // generate indices vector 
     vector<unsigned int> indices;
+    indices.reserve(positions.size());
     for (int i=0;i<positions.size();i++)
     {
         indices.push_back(i);
@@ -3,21 +3,165 @@
 
 #include <PolygonMesh.h>
 #include "VertexAttrib.h"
+#include "LruCache.h"
+#include "GearTrain.h"
+#include "FourierCurve.h"
+#include "Shape.h"
 #include <vector>
+#include <memory>
+#include <mutex>
 using namespace std;
 
 // Header for Model of Spirograph program.
+
+#define CURVE_LEVEL_TOLERANCE 1.0f // tolerance of the first coarser level of detail, in model units
+#define CURVE_CHUNK_SIZE 256 // segments of the curve in one chunk
+#define CURVE_CACHE_BYTES (64 << 20) // memory for generated curves kept by Model::getCurve
+#define RADIUS_STEP 5 // change of the inner radius per key press
+#define MIN_SMALL_RADIUS 5 // range of the inner radius
+#define MAX_SMALL_RADIUS 400
+#define MAX_PENS 8 // pens on the inner circle
+#define GEAR_TRAIN_POINTS 100000 // points of the curve of a train of several gears
+#define MAX_GEAR_TRAIN_ANGLE (200 * M_PI) // longest stretch of such a curve, when it takes longer to close
+#define FOURIER_POINTS 65536 // points of a Fourier curve, unless arc-length points are set
+#define SHAPE_POINTS 50000 // points of the curve of shaped gears, unless arc-length points are set
+#define SHAPE_CIRCLE_POINTS 4096 // points of the outline standing in for a round ring or gear
+
+// One level of detail of the curve: a line strip within the curve mesh.
+struct CurveLevel {
+    int first; // first index of the level in the curve mesh
+    int count; // number of indices in the level
+    float error; // largest distance from the finest level, in model units
+    int firstChunk; // first of the chunks the level is split into
+    int chunkCount;
+};
+
+// A stretch of CURVE_CHUNK_SIZE segments of one level of detail and its
+// bounding box, for drawing only the parts of the curve that are in view.
+// Chunks of a level share their end points, so drawn one after another
+// they make up the whole line strip.
+struct CurveChunk {
+    int first; // first index of the chunk in the curve mesh
+    int count; // number of indices in the chunk
+    glm::vec2 minimum; // corners of the bounding box
+    glm::vec2 maximum;
+};
+
+// Everything a generated curve depends on, to find it in the curve cache.
+struct CurveKey {
+    int bigRadius;
+    int smallRadius;
+    vector<double> penOffsets; // see Model::setPenOffsets
+    double tolerance; // see Model::setCurveTolerance
+    int arcLengthPoints;
+    int levelCount;
+    bool symmetryInstancing;
+    bool outsideRolling;
+    vector<Gear> nestedGears;
+    shared_ptr<const FourierCurve> fourierCurve; // told apart by address
+    shared_ptr<const Shape> ringShape; // likewise
+    shared_ptr<const Shape> gearShape;
+
+    bool operator<(const CurveKey& other) const;
+    bool operator==(const CurveKey& other) const;
+};
+
+// A generated curve: its meshes, the levels of detail within them (those
+// of the first pen, then those of the next), the chunks the levels are
+// split into and how many turned copies to draw.
+struct CurveData {
+    CurveKey key; // parameters it was made for
+    vector<util::PolygonMesh<VertexAttrib> > meshes;
+    vector<CurveLevel> levels;
+    vector<CurveChunk> chunks;
+    int lobeCount; // see Model::getLobeCount
+    double lobeAngle;
+    int penCount; // line strips, each with levels.size() / penCount levels of detail
+    size_t bytes; // memory held by the curve
+};
+
 class Model 
 {
+    friend class ModelBench; // bench/ModelBench.cpp times the private mesh builders
+
 public:
     Model();
     ~Model();
     vector<util::PolygonMesh<VertexAttrib> > getCircleMesh(); // returns mesh for a circle
     vector<util::PolygonMesh<VertexAttrib> > getCurveMesh(); // returns mesh for a circle
+
+    // the curve for the current parameters, from the curve cache when it
+    // was made before (the returned curve is never changed afterwards)
+    shared_ptr<const CurveData> getCurve();
+    shared_ptr<CurveData> makeCurve(); // makes the curve for the current parameters, bypassing the cache
+    CurveKey getCurveKey(); // parameters the next curve would be made for
+    void setCurveKey(const CurveKey& key); // takes on the parameters of key
+
+    // The curve cache may be used from other threads, as by CurvePrefetcher;
+    // the rest of the model belongs to one thread.
+    bool hasCurve(const CurveKey& key); // true if the curve of key is cached
+    void addCurve(const shared_ptr<const CurveData>& curve); // caches a curve made elsewhere
+    void logCurveCacheStats(); // logs hits, misses and memory of the curve cache
     int getSmallCircRadius(); // returns the radius of smaller inner circle
     int getBigCircRadius(); // returns the radius of bigger outer circle
     void changeInnerCircRadius(int amt); // changes the inner circle radius value by amt & remakes mesh
 
+    // largest distance allowed between the curve and the line strip drawn for it,
+    // in model units; 0 goes back to sampling the curve at a fixed step
+    void setCurveTolerance(double tolerance);
+
+    // respaces the curve to this many points evenly spread along its length
+    // (for constant pen speed and plotter output); 0 keeps the sampler's spacing
+    void setArcLengthPoints(int points);
+
+    // number of levels of detail in the curve mesh, the finest first, each
+    // decimated from the one before with four times the error; 1 for just the curve
+    void setCurveLevelCount(int levels);
+    vector<CurveLevel> getCurveLevels(); // levels of detail of the curve mesh, pen by pen
+    vector<CurveChunk> getCurveChunks(); // chunks of all levels of the curve mesh
+
+    // With integer radii the pattern is made of R / gcd(R, r) copies of one
+    // lobe, each turned by getLobeAngle() from the one before. When on, the
+    // curve mesh only holds the first lobe, to be drawn getLobeCount() times.
+    void setSymmetryInstancing(bool on);
+    int getLobeCount(); // copies of the curve mesh making up the pattern, 1 if not instancing
+    double getLobeAngle(); // rotation from one copy to the next
+
+    // Distances of the pens from the centre of the last gear (the inner
+    // circle unless nested gears are set), as fractions of its radius
+    // ({0.5} at first, at most MAX_PENS). Each pen draws a curve
+    // of its own; all of them are sampled in one pass that works out the
+    // path of the inner circle only once.
+    void setPenOffsets(const vector<double>& offsets);
+    vector<double> getPenOffsets();
+    int getPenCount();
+    double getPenOffset(int pen); // distance of a pen from the centre of the last gear in model units
+
+    // The inner circle rolls inside the outer one (a hypotrochoid) or around
+    // its outside (an epitrochoid). More gears may roll on it and on each
+    // other, each inside or outside the one before; the pens are then on
+    // the last one and the curve is sampled from the GearTrain.
+    void setOutsideRolling(bool on);
+    bool isOutsideRolling();
+    void setNestedGears(const vector<Gear>& gears); // at most MAX_GEARS - 1
+    GearTrain getGearTrain(); // outer circle, inner circle and nested gears
+
+    // draws this Fourier series instead of the circles' curve, NULL to go back
+    void setFourierCurve(const shared_ptr<const FourierCurve>& curve);
+    bool isFourierMode();
+
+    // Rolls a gear of this outline inside (or outside) a ring of that one
+    // instead of the circles, NULL for a circle of the usual radius. The pen
+    // offsets are then fractions of the gear's reach, and the nested gears,
+    // tolerance and symmetry settings do not apply.
+    void setRingShape(const shared_ptr<const Shape>& shape);
+    void setGearShape(const shared_ptr<const Shape>& shape);
+    bool isShapeMode(); // either outline is set
+
+    // threads the curve of shaped gears is sampled on, 1 at first; a model
+    // making curves in the background keeps to 1 so as not to take every core
+    void setSamplingThreads(int threads);
+
 private:
     vector<util::PolygonMesh<VertexAttrib> > circleMesh; // makes mesh for a unit circle
     vector<util::PolygonMesh<VertexAttrib> > curveMesh; // makes mesh for a curve
@@ -26,20 +170,57 @@ private:
     float twicePi; // constant for PI
     double smallCircPosX; // x-coordinate of inner circle
     double smallCircPosY; // y-coordinate of inner circle
+    double curveTolerance; // largest chord error of the curve, 0 for a fixed step
+    int arcLengthPoints; // points evenly spaced by arc length, 0 if not respaced
+    int curveLevelCount; // levels of detail made for the curve
+    vector<CurveLevel> curveLevels; // levels of detail of the curve mesh
+    vector<CurveChunk> curveChunks; // chunks of all levels, in index order
+    bool symmetryInstancing; // the curve mesh holds one lobe of the pattern
+    vector<double> penOffsets; // pens as fractions of the radius of the last gear
+    bool outsideRolling; // the inner circle rolls around the outside of the outer one
+    vector<Gear> nestedGears; // rolling on the inner circle, the pens on the last
+    shared_ptr<const FourierCurve> fourierCurve; // drawn instead when set
+    shared_ptr<const Shape> ringShape; // outline of the outer circle when set
+    shared_ptr<const Shape> gearShape; // outline of the inner circle when set
+    int samplingThreads; // threads sampleShapes works on
+    LruCache<CurveKey, shared_ptr<const CurveData> > curveCache; // recently made curves
+    mutex curveCacheLock; // guards curveCache
     void makeCircleMesh(); // creates mesh for a circle
     void makeDrawingCurveMesh(); // creates mesh for the curve
+    double curveEnd(); // last angle of the inner circle centre the curve is made for
+
+    // the samplers fill in one line strip per pen
+    void sampleFixedStep(vector<vector<glm::vec4> >& pens); // 20000 points a fixed arc step apart
+    void sampleAdaptive(vector<vector<glm::vec4> >& pens); // points spaced by the curvature
+    double adaptiveStep(double theta, double maxStep); // angle step keeping the chord error in tolerance
+    void sampleGearTrain(vector<vector<glm::vec4> >& pens); // a train of several gears over its period
+    void sampleFourier(vector<glm::vec4>& positions); // the Fourier curve by inverse FFT
+    void sampleShapes(vector<vector<glm::vec4> >& pens); // a shaped gear rolling on a shaped ring
+    double rollingDistance(); // distance between the centres of the circles
+    double rollRate(); // turns of the inner circle per turn of its centre
+    void sampleUniformArcLength(vector<vector<glm::vec4> >& pens); // arcLengthPoints evenly spaced points
+    void carrier(double theta, glm::dvec2& centre, glm::dvec2& arm); // inner circle centre and turn at theta
+    void addPenPositions(double theta, vector<vector<glm::vec4> >& pens); // appends every pen at theta
+    glm::vec4 penPosition(double theta, double penOffset); // pen position when the inner circle centre is at angle theta
+    double penSpeed(double theta, double penOffset); // length of the derivative of penPosition by theta
+    double arcLength(double theta1, double theta2, double penOffset); // length of the curve between two angles
+
+    // appends the coarser levels of detail of the line strip positions[first, end)
+    void makeCurveLevels(vector<glm::vec4>& positions, int first);
+    void makeCurveChunks(util::PolygonMesh<VertexAttrib>& mesh); // splits every level into chunks
 
-    // finds seed position based on seed and inner circle position and angles provided
-    glm::vec4 doubleRotate(glm::vec4 cp, glm::vec4 sp, float deltaTheta1, float deltaTheta2);
+    // appends the points of positions[first, first + count) that a line strip
+    // within tolerance of all of them needs, returns how many were appended
+    int decimate(vector<glm::vec4>& positions, int first, int count, float tolerance);
 
     // calculates distance between first and given points
     float calcDistance(float x1, float y1, float x2, float y2); 
 
     // creates mesh from positions vector given
-    util::PolygonMesh<VertexAttrib> createMeshFromPositions(vector<glm::vec4> positions); 
+    util::PolygonMesh<VertexAttrib> createMeshFromPositions(const vector<glm::vec4>& positions); 
 
     // creates vertex points from positions vector given
-    vector<VertexAttrib> createVertexData(vector<glm::vec4> positions); 
+    vector<VertexAttrib> createVertexData(const vector<glm::vec4>& positions); 
 
 };
 #endif
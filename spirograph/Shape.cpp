@@ -0,0 +1,189 @@
+#include "Shape.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include "spdlog/spdlog.h"
+
+// Implementation of Shape of Program.
+
+Shape::Shape() {
+}
+
+// Centres the outline on its centroid, turns it counter-clockwise, starts
+// it at its point furthest along +x and works out the arc lengths and the
+// direction at every point.
+Shape Shape::fromPolyline(const vector<glm::dvec2>& outline) {
+    Shape shape;
+    int n = outline.size();
+    if (n < 3) {
+        return shape;
+    }
+
+    // centroid and signed area of the polygon
+    double area = 0;
+    glm::dvec2 centroid(0, 0);
+    for (int i = 0; i < n; i++) {
+        const glm::dvec2& a = outline[i];
+        const glm::dvec2& b = outline[(i + 1) % n];
+        double cross = a.x * b.y - b.x * a.y;
+        area += cross / 2;
+        centroid += (a + b) * (cross / 6);
+    }
+    centroid = fabs(area) > 1e-12 ? centroid / area : outline[0];
+
+    int first = 0;
+    for (int i = 1; i < n; i++) {
+        if (outline[i].x > outline[first].x) {
+            first = i;
+        }
+    }
+    shape.points.reserve(n + 1);
+    for (int i = 0; i <= n; i++) {
+        // clockwise outlines are walked backwards
+        int j = area >= 0 ? (first + i) % n : ((first - i) % n + n) % n;
+        shape.points.push_back(outline[j] - centroid);
+    }
+
+    shape.table.reserve(n + 1);
+    shape.table.add(0, 0);
+    for (int i = 1; i <= n; i++) {
+        shape.table.add(i, glm::length(shape.points[i] - shape.points[i - 1]));
+    }
+
+    // direction at a point from the chord between its neighbours, each
+    // brought within half a turn of the one before
+    shape.directions.resize(n + 1);
+    for (int i = 0; i < n; i++) {
+        glm::dvec2 chord = shape.points[i + 1] - shape.points[(i + n - 1) % n];
+        double direction = atan2(chord.y, chord.x);
+        if (i > 0) {
+            double previous = shape.directions[i - 1];
+            direction = direction + 2 * M_PI * round((previous - direction) / (2 * M_PI));
+        }
+        shape.directions[i] = direction;
+    }
+    // a simple closed outline turns once
+    shape.directions[n] = shape.directions[0] + 2 * M_PI;
+    return shape;
+}
+
+// semi-axes a along x and b along y, starting at (a, 0)
+Shape Shape::ellipse(double a, double b, int points) {
+    vector<glm::dvec2> outline;
+    outline.reserve(points);
+    for (int i = 0; i < points; i++) {
+        double t = 2 * M_PI * i / points;
+        outline.push_back(glm::dvec2(a * cos(t), b * sin(t)));
+    }
+    return fromPolyline(outline);
+}
+
+// "circle:r", "ellipse:a,b" or a file of "x y" lines
+bool Shape::parse(const char *description, Shape& shape) {
+    double a, b;
+    int end = 0;
+    // a description naming a shape is never taken for a file, however mistyped
+    if (strncmp(description, "circle:", 7) == 0) {
+        if (sscanf(description, "circle:%lf%n", &a, &end) != 1 || description[end] != '\0' || !(a > 0)) {
+            spdlog::error("{} is not circle:r with a radius above 0", description);
+            return false;
+        }
+        shape = ellipse(a, a, 4096);
+        return true;
+    }
+    if (strncmp(description, "ellipse:", 8) == 0) {
+        if (sscanf(description, "ellipse:%lf,%lf%n", &a, &b, &end) != 2 || description[end] != '\0'
+            || !(a > 0) || !(b > 0)) {
+            spdlog::error("{} is not ellipse:a,b with semi-axes above 0", description);
+            return false;
+        }
+        shape = ellipse(a, b, 4096);
+        return true;
+    }
+    FILE *in = fopen(description, "r");
+    if (in == NULL) {
+        spdlog::error("{} is neither a shape nor a file of points", description);
+        return false;
+    }
+    vector<glm::dvec2> outline;
+    char line[256];
+    int lineNumber = 0;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        lineNumber++;
+        char first;
+        if (sscanf(line, " %c", &first) != 1 || first == '#') {
+            continue;
+        }
+        if (sscanf(line, "%lf %lf", &a, &b) != 2) {
+            spdlog::error("{}:{} is not a point", description, lineNumber);
+            fclose(in);
+            return false;
+        }
+        outline.push_back(glm::dvec2(a, b));
+    }
+    fclose(in);
+    if (outline.size() < 3) {
+        spdlog::error("{} holds fewer than 3 points", description);
+        return false;
+    }
+    shape = fromPolyline(outline);
+    return true;
+}
+
+double Shape::getLength() const {
+    return table.getLength();
+}
+
+// largest distance of a point from the centre
+double Shape::getReach() const {
+    double reach = 0;
+    for (unsigned int i = 0; i < points.size(); i++) {
+        reach = max(reach, glm::length(points[i]));
+    }
+    return reach;
+}
+
+// arc length at the point furthest along -x
+double Shape::getLeftmost() const {
+    int leftmost = 0;
+    for (unsigned int i = 1; i < points.size(); i++) {
+        if (points[i].x < points[leftmost].x) {
+            leftmost = i;
+        }
+    }
+    return table.getArcLength(leftmost);
+}
+
+// turns left or goes straight at every point and once around in all, as the
+// outline is counter-clockwise (a star turns left throughout but twice around)
+bool Shape::isConvex() const {
+    int n = (int) points.size() - 1;
+    if (n < 3) {
+        return false;
+    }
+    double turning = 0;
+    for (int i = 0; i < n; i++) {
+        glm::dvec2 in = points[i + 1] - points[i];
+        glm::dvec2 out = points[(i + 1) % n + 1] - points[(i + 1) % n];
+        double cross = in.x * out.y - in.y * out.x;
+        if (cross < -1e-9 * glm::length(in) * glm::length(out)) {
+            return false;
+        }
+        turning += atan2(cross, glm::dot(in, out));
+    }
+    return turning < 3 * M_PI;
+}
+
+// point and direction at arc length s, by binary search in the table
+void Shape::at(double s, glm::dvec2& position, double& direction) const {
+    double length = table.getLength();
+    double laps = floor(s / length);
+    s = s - laps * length;
+    int i = table.findSegment(s);
+    double start = table.getArcLength(i);
+    double segment = table.getArcLength(i + 1) - start;
+    double t = segment > 0 ? (s - start) / segment : 0;
+    position = points[i] + (points[i + 1] - points[i]) * t;
+    direction = directions[i] + (directions[i + 1] - directions[i]) * t + 2 * M_PI * laps;
+}
@@ -0,0 +1,45 @@
+#ifndef __SHAPE_H__
+#define __SHAPE_H__
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "ArcLengthTable.h"
+using namespace std;
+
+// Header for Shape of Spirograph program.
+// The outline of a ring or gear that need not be round: a closed polyline,
+// counter-clockwise, centred on its centroid and starting at its point
+// furthest along +x. A cumulative arc-length table finds the point and the
+// direction of the outline at any distance along it by binary search. The
+// direction is interpolated between the vertices, so a finely sampled
+// smooth outline rolls smoothly.
+
+class Shape
+{
+public:
+    Shape();
+
+    static Shape fromPolyline(const vector<glm::dvec2>& points); // closed, either way round
+    static Shape ellipse(double a, double b, int points); // semi-axes a along x and b along y
+
+    // "circle:r", "ellipse:a,b" or a file of "x y" lines, where empty lines
+    // and lines starting with # are skipped; false if it cannot be read or
+    // is malformed
+    static bool parse(const char *description, Shape& shape);
+
+    double getLength() const; // around the whole outline
+    double getReach() const; // largest distance of a point from the centre
+    double getLeftmost() const; // arc length at the point furthest along -x
+    bool isConvex() const; // turns left or goes straight at every point, once around
+
+    // point and direction (as an angle, growing by 2 pi every lap) at arc
+    // length s, which may be more than a lap or negative
+    void at(double s, glm::dvec2& position, double& direction) const;
+
+private:
+    vector<glm::dvec2> points; // the first again at the end
+    vector<double> directions; // at every point, from its neighbours, unwrapped
+    ArcLengthTable table; // arc length at every point, by index
+};
+
+#endif
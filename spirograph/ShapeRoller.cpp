@@ -0,0 +1,83 @@
+#include "ShapeRoller.h"
+#include <cmath>
+#include <thread>
+#include "Trace.h"
+
+// Implementation of ShapeRoller of Program.
+
+// the gear starts touching the start of the ring (its point furthest
+// along +x) with its own point furthest along +x when inside, and with
+// its point furthest along -x when outside
+ShapeRoller::ShapeRoller(const Shape& ring, const Shape& gear, bool outside)
+    : ring(ring), gear(gear), outside(outside) {
+    start = outside ? gear.getLeftmost() : 0;
+}
+
+// the first whole number of laps of the ring that is within a thousandth
+// of a whole number of laps of the gear
+double ShapeRoller::getEnd() const {
+    double ratio = ring.getLength() / gear.getLength();
+    for (int laps = 1; laps < MAX_SHAPE_LAPS; laps++) {
+        double gearLaps = laps * ratio;
+        if (fabs(gearLaps - round(gearLaps)) < 1e-3) {
+            return laps * ring.getLength();
+        }
+    }
+    return MAX_SHAPE_LAPS * ring.getLength();
+}
+
+// The contact point moves along both outlines at the same rate, so the
+// gear's direction there, turned by the rotation, is the ring's (reversed
+// outside, where the gear's outline is walked backwards). The centre is
+// then where the turned contact point of the gear lands on the ring's.
+void ShapeRoller::getPose(double s, glm::dvec2& centre, double& rotation) const {
+    glm::dvec2 ringPoint, gearPoint;
+    double ringDirection, gearDirection;
+    ring.at(s, ringPoint, ringDirection);
+    gear.at(outside ? start - s : start + s, gearPoint, gearDirection);
+    rotation = ringDirection - gearDirection - (outside ? M_PI : 0);
+    double c = cos(rotation);
+    double si = sin(rotation);
+    centre = ringPoint - glm::dvec2(c * gearPoint.x - si * gearPoint.y, si * gearPoint.x + c * gearPoint.y);
+}
+
+// appends count points evenly spaced from 0 to end, split between threads
+void ShapeRoller::sample(int count, double end, const vector<double>& penOffsets,
+                         vector<vector<glm::vec4> >& pens, int threads) const {
+    TRACE_SCOPE("ShapeRoller::sample");
+    int offset = pens.empty() ? 0 : pens[0].size();
+    // every thread writes its own stretch of the strips, so they are sized first
+    for (unsigned int j = 0; j < pens.size(); j++) {
+        pens[j].resize(offset + count);
+    }
+    double step = count > 1 ? end / (count - 1) : 0;
+    threads = max(1, min(threads, count / MIN_POINTS_PER_THREAD));
+    vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    int share = (count + threads - 1) / threads;
+    for (int t = 1; t < threads; t++) {
+        int first = t * share;
+        int last = min(first + share, count);
+        workers.push_back(std::thread(&ShapeRoller::sampleRange, this, first, last, step,
+                                      std::cref(penOffsets), std::ref(pens), offset));
+    }
+    sampleRange(0, min(share, count), step, penOffsets, pens, offset);
+    for (unsigned int t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+}
+
+// samples [first, last) into pens from index offset on
+void ShapeRoller::sampleRange(int first, int last, double step, const vector<double>& penOffsets,
+                              vector<vector<glm::vec4> >& pens, int offset) const {
+    for (int i = first; i < last; i++) {
+        glm::dvec2 centre;
+        double rotation;
+        getPose(i * step, centre, rotation);
+        glm::dvec2 arm(cos(rotation), sin(rotation));
+        for (unsigned int j = 0; j < pens.size(); j++) {
+            glm::dvec2 pen = centre + penOffsets[j] * arm;
+            pens[j][offset + i] = glm::vec4(pen.x, pen.y, 0.0f, 1.0f);
+        }
+    }
+}
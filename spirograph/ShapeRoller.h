@@ -0,0 +1,50 @@
+#ifndef __SHAPEROLLER_H__
+#define __SHAPEROLLER_H__
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "Shape.h"
+using namespace std;
+
+// Header for ShapeRoller of Spirograph program.
+// Rolls a gear Shape without slipping inside or around the outside of a
+// ring Shape. After rolling a distance s along the ring, the gear touches
+// it at arc length start + s of its own outline (start - s outside), and
+// is turned so that the outlines run the same way at the contact point.
+// Each sample is worked out on its own from the two arc-length tables, so
+// the samples are split between threads. The outlines should be convex,
+// and a gear inside must be curved at least as much as the ring everywhere.
+
+#define MAX_SHAPE_LAPS 64 // laps of the ring rolled when the pattern does not close sooner
+#define MIN_POINTS_PER_THREAD 4096 // fewer points are not worth starting a thread for
+
+class ShapeRoller
+{
+public:
+    ShapeRoller(const Shape& ring, const Shape& gear, bool outside);
+
+    // distance along the ring after which the gear is back where it started
+    // (a whole number of laps of both), MAX_SHAPE_LAPS laps if it takes longer
+    double getEnd() const;
+
+    // centre of the gear and its rotation after rolling s along the ring
+    void getPose(double s, glm::dvec2& centre, double& rotation) const;
+
+    // appends count points evenly spaced from 0 to end along the ring to one
+    // line strip per pen, the pens penOffsets[i] along +x of the gear from its
+    // centre, working on as many as threads threads
+    void sample(int count, double end, const vector<double>& penOffsets,
+                vector<vector<glm::vec4> >& pens, int threads) const;
+
+private:
+    const Shape& ring;
+    const Shape& gear;
+    bool outside; // the gear rolls around the outside of the ring
+    double start; // arc length of the gear touching the start of the ring
+
+    // samples [first, last) into pens from index offset on
+    void sampleRange(int first, int last, double step, const vector<double>& penOffsets,
+                     vector<vector<glm::vec4> >& pens, int offset) const;
+};
+
+#endif
@@ -0,0 +1,237 @@
+#include "Simulation.h"
+#include <chrono>
+#include <cstdio>
+#include <GLFW/glfw3.h>
+#include "spdlog/spdlog.h"
+#include "Trace.h"
+#include "AllocationTracker.h"
+
+// Implementation of Simulation of Program.
+
+Simulation::Simulation(Model *m) : clock(SIMULATION_STEP, 0.25), prefetcher(m), commandHead(0), commandTail(0), running(false) {
+    model = m;
+    driven = false;
+    showCurve = true; // initially show curve
+    previousPenAngle = 0.0;
+    curveVersion = 0; // the curve the model made on construction
+    advances = 0;
+    timeline = NULL;
+    timelineTime = 0;
+    timelineFrame = -1;
+}
+
+Simulation::~Simulation() {
+    stop();
+}
+
+// publishes the first state and starts the thread
+void Simulation::start(bool driven) {
+    this->driven = driven;
+    curve = model->getCurve(); // the View has just drawn it, so it is in the curve cache
+    if (timeline != NULL) {
+        followTimeline(0);
+    }
+    else {
+        prefetcher.request(curve->key);
+    }
+    publish(glfwGetTime());
+    running.store(true);
+    worker = std::thread(&Simulation::run, this);
+}
+
+// stops the thread and prefetching, returns once they have finished
+void Simulation::stop() {
+    if (running.exchange(false)) {
+        worker.join();
+    }
+    prefetcher.stop();
+}
+
+// starts making the curves of the nearest radii in the background
+void Simulation::startPrefetching() {
+    prefetcher.start();
+}
+
+// plays this planned timeline from the start, as time passes; set before start
+void Simulation::setTimeline(const Timeline *timeline) {
+    this->timeline = timeline;
+    timelineTime = 0;
+    timelineFrame = -1;
+}
+
+// called on the render thread, false if the queue is full
+bool Simulation::post(SimulationCommand::Type type, int amount, double value) {
+    unsigned int head = commandHead.load(std::memory_order_relaxed);
+    if (head - commandTail.load(std::memory_order_acquire) == QUEUE_CAPACITY) {
+        return false;
+    }
+    SimulationCommand& command = commands[head & (QUEUE_CAPACITY - 1)];
+    command.type = type;
+    command.amount = amount;
+    command.value = value;
+    commandHead.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+// called on the render thread, latest published state
+const SimulationState& Simulation::latest() {
+    return states.read();
+}
+
+// pops a posted command
+bool Simulation::nextCommand(SimulationCommand& command) {
+    unsigned int tail = commandTail.load(std::memory_order_relaxed);
+    if (tail == commandHead.load(std::memory_order_acquire)) {
+        return false;
+    }
+    command = commands[tail & (QUEUE_CAPACITY - 1)];
+    commandTail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+// body of the simulation thread
+void Simulation::run() {
+    double lastTime = glfwGetTime();
+    while (running.load()) {
+        {
+            TRACE_SCOPE("Simulation::run");
+            SimulationCommand command;
+            while (nextCommand(command)) {
+                apply(command);
+            }
+            double now = glfwGetTime();
+            if (!driven) {
+                advance(now - lastTime);
+            }
+            lastTime = now;
+            publish(now);
+        }
+
+        // sleep until the next step is due; a driven simulation only waits for commands,
+        // and the render thread waits for each ADVANCE, so its nap is kept short
+        double wait = driven ? 0.0001 : (1.0 - clock.getAlpha()) * clock.getStep();
+        std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+    }
+}
+
+// reacts to a posted command
+void Simulation::apply(const SimulationCommand& command) {
+    // a Fourier curve has no circles or pens, so it would be made again unchanged
+    bool circleCommand = command.type == SimulationCommand::CHANGE_RADIUS
+        || command.type == SimulationCommand::CHANGE_PEN_OFFSET || command.type == SimulationCommand::TOGGLE_OUTSIDE;
+    if (circleCommand && model->isFourierMode()) {
+        return;
+    }
+    if (command.type == SimulationCommand::CHANGE_RADIUS) {
+        ALLOC_PHASE("regeneration");
+        int radius = model->getSmallCircRadius() + command.amount;
+        if (radius < MIN_SMALL_RADIUS || radius > MAX_SMALL_RADIUS) {
+            return;
+        }
+        model->changeInnerCircRadius(command.amount);
+        regenerate();
+    }
+    else if (command.type == SimulationCommand::SET_CURVE_TOLERANCE) {
+        ALLOC_PHASE("regeneration");
+        model->setCurveTolerance(command.value);
+        regenerate();
+    }
+    else if (command.type == SimulationCommand::CHANGE_PEN_OFFSET) {
+        ALLOC_PHASE("regeneration");
+        vector<double> offsets = model->getPenOffsets();
+        for (unsigned int i = 0; i < offsets.size(); i++) {
+            offsets[i] = max(offsets[i] + command.value, 0.0);
+        }
+        model->setPenOffsets(offsets);
+        regenerate();
+    }
+    else if (command.type == SimulationCommand::TOGGLE_OUTSIDE) {
+        ALLOC_PHASE("regeneration");
+        model->setOutsideRolling(!model->isOutsideRolling());
+        regenerate();
+    }
+    else if (command.type == SimulationCommand::TOGGLE_PEN) {
+        if (showCurve) {
+            showCurve = false;
+            printf("showCurve turned off\n");
+        }
+        else {
+            showCurve = true;
+            printf("showCurve turned on\n");
+        }
+    }
+    else if (command.type == SimulationCommand::ADVANCE) {
+        advance(command.value);
+        advances++;
+    }
+}
+
+// makes the curve again after a change of the model
+void Simulation::regenerate() {
+    // a curve seen before comes straight from the curve cache
+    curve = model->getCurve();
+    curveVersion = curveVersion + 1;
+    prefetcher.request(curve->key);
+}
+
+// moves the pen by whole simulation steps for the elapsed time
+void Simulation::advance(double elapsed) {
+    if (timeline != NULL) {
+        followTimeline(elapsed);
+    }
+
+    // the pen stands still while the curve is hidden
+    if (!showCurve) {
+        clock.reset();
+        previousPenAngle = penAngle.get();
+        return;
+    }
+
+    // the contact point of the circles moves PEN_SPEED units along the outer circle per second
+    double deltaTheta = PEN_SPEED / model->getBigCircRadius() * clock.getStep();
+    int steps = clock.advance(elapsed);
+    for (int i=0;i<steps;i++) {
+        previousPenAngle = penAngle.get();
+        penAngle.add(deltaTheta);
+    }
+}
+
+// takes the curve of the timeline frame now due; it was made when the
+// timeline was planned, so nothing is regenerated
+void Simulation::followTimeline(double elapsed) {
+    timelineTime = timelineTime + elapsed;
+    int frame = timeline->getFrameAt(timelineTime);
+    if (frame == timelineFrame) {
+        return;
+    }
+    timelineFrame = frame;
+    const shared_ptr<const CurveData>& next = timeline->getFrameCurve(frame);
+    if (next == curve) {
+        return;
+    }
+    // the model takes on the frame's parameters, for the circles and for keys pressed meanwhile
+    curve = next;
+    model->setCurveKey(curve->key);
+    curveVersion = curveVersion + 1;
+}
+
+// hands the current state to the render thread
+void Simulation::publish(double now) {
+    SimulationState state;
+    state.penAngle = penAngle.get();
+    state.previousPenAngle = previousPenAngle;
+    state.alpha = clock.getAlpha();
+    state.time = now;
+    state.bigCircRadius = model->getBigCircRadius();
+    state.smallCircRadius = model->getSmallCircRadius();
+    state.train = model->getGearTrain();
+    state.drawCircles = !model->isFourierMode() && !model->isShapeMode();
+    state.penCount = model->getPenCount();
+    for (int i = 0; i < state.penCount; i++) {
+        state.penOffsets[i] = model->getPenOffset(i);
+    }
+    state.curveVersion = curveVersion;
+    state.advances = advances;
+    state.curve = curve;
+    states.write(state);
+}
@@ -0,0 +1,110 @@
+#ifndef __SIMULATION_H__
+#define __SIMULATION_H__
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include "Model.h"
+#include "CurvePrefetcher.h"
+#include "Timeline.h"
+#include "SimulationClock.h"
+#include "TripleBuffer.h"
+#include "CompensatedSum.h"
+
+// Header for Simulation of Spirograph program.
+// Moves the pen and applies parameter changes on a thread of its own, so
+// that drawing never waits for a step or for the curve to be regenerated.
+// The View posts commands through a lock-free queue and draws the latest
+// SimulationState, which the simulation thread publishes after every pass
+// through a TripleBuffer.
+
+#define SIMULATION_STEP (1.0 / 120.0) // seconds per simulation step of the pen
+#define PEN_SPEED 600.0 // units per second the contact point travels along the outer circle
+#define PEN_OFFSET_STEP 0.05 // change of the pen offsets per key press, as a fraction of the inner radius
+
+// What the View needs to draw one frame. Copied as a whole when published.
+struct SimulationState {
+    double penAngle; // angle the inner circle centre has travelled around the outer circle
+    double previousPenAngle; // penAngle one simulation step earlier
+    double alpha; // time left over in the clock, as a fraction of a step
+    double time; // glfwGetTime() when the state was published
+    int bigCircRadius; // radius of outer circle
+    int smallCircRadius; // radius of inner circle
+    GearTrain train; // the inner circle and any gears rolling on it
+    bool drawCircles; // false when the curve is a Fourier series or made by shaped gears
+    int penCount;
+    double penOffsets[MAX_PENS]; // distances of the pens from the centre of the last gear
+    unsigned long curveVersion; // counts regenerations of the curve
+    unsigned long advances; // ADVANCE commands applied so far
+    shared_ptr<const CurveData> curve; // curve of curveVersion
+};
+
+struct SimulationCommand {
+    enum Type {
+        CHANGE_RADIUS, // changes the inner circle radius by amount
+        TOGGLE_PEN, // stops or restarts the pen
+        ADVANCE, // simulates value seconds, only used when driven
+        SET_CURVE_TOLERANCE, // resamples the curve within value model units
+        CHANGE_PEN_OFFSET, // moves every pen value radii of its gear further out
+        TOGGLE_OUTSIDE // rolls the inner circle around the outside of the outer one or back inside
+    };
+    Type type;
+    int amount;
+    double value;
+};
+
+class Simulation
+{
+public:
+    Simulation(Model *m);
+    ~Simulation();
+
+    // publishes the first state and starts the thread; a driven simulation
+    // only lets time pass on ADVANCE commands, otherwise it follows the wall clock
+    void start(bool driven);
+    void stop(); // stops the thread and prefetching, returns once they have finished
+    void startPrefetching(); // starts making the curves of the nearest radii in the background
+
+    // plays this planned timeline from the start, as time passes; set before start
+    void setTimeline(const Timeline *timeline);
+
+    // called on the render thread, never block
+    bool post(SimulationCommand::Type type, int amount = 0, double value = 0); // false if the queue is full
+    const SimulationState& latest(); // latest published state
+
+private:
+    static const unsigned int QUEUE_CAPACITY = 256; // commands, a power of two
+
+    Model *model; // only used on the simulation thread once started
+    SimulationClock clock; // fixed steps for the pen animation
+    bool driven; // time only passes on ADVANCE commands
+    bool showCurve; // the pen stands still while the curve is hidden
+    CompensatedSum penAngle; // a step at a time for as long as the program runs
+    double previousPenAngle;
+    unsigned long curveVersion;
+    unsigned long advances; // ADVANCE commands applied
+    shared_ptr<const CurveData> curve;
+    TripleBuffer<SimulationState> states;
+    CurvePrefetcher prefetcher; // warms the curve cache for the next radius change
+    const Timeline *timeline; // played back when set
+    double timelineTime; // seconds of the timeline played
+    int timelineFrame; // frame of the timeline the curve is of
+
+    // single-producer single-consumer queue from the render thread
+    SimulationCommand commands[QUEUE_CAPACITY];
+    alignas(64) std::atomic<unsigned int> commandHead; // next slot to write, owned by the render thread
+    alignas(64) std::atomic<unsigned int> commandTail; // next slot to read, owned by the simulation thread
+
+    std::atomic<bool> running;
+    std::thread worker;
+
+    void run(); // body of the simulation thread
+    bool nextCommand(SimulationCommand& command); // pops a posted command
+    void apply(const SimulationCommand& command); // reacts to a posted command
+    void regenerate(); // makes the curve again after a change of the model
+    void advance(double elapsed); // moves the pen by whole steps for the elapsed time
+    void followTimeline(double elapsed); // takes the curve of the timeline frame now due
+    void publish(double now); // hands the current state to the render thread
+};
+
+#endif
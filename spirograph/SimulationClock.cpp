@@ -0,0 +1,40 @@
+#include "SimulationClock.h"
+
+// Implementation of SimulationClock of Program.
+
+SimulationClock::SimulationClock(double step, double maxElapsed) {
+    this->step = step;
+    this->maxElapsed = maxElapsed;
+    accumulator = 0;
+}
+
+// adds wall time, returns the number of steps to simulate
+int SimulationClock::advance(double elapsed) {
+    if (elapsed > maxElapsed) {
+        elapsed = maxElapsed;
+    }
+    if (elapsed > 0) {
+        accumulator = accumulator + elapsed;
+    }
+    int steps = 0;
+    while (accumulator >= step) {
+        accumulator = accumulator - step;
+        steps = steps + 1;
+    }
+    return steps;
+}
+
+// leftover time as a fraction of a step, in [0,1)
+double SimulationClock::getAlpha() {
+    return accumulator / step;
+}
+
+// length of one step in seconds
+double SimulationClock::getStep() {
+    return step;
+}
+
+// drops leftover time, e.g. while paused
+void SimulationClock::reset() {
+    accumulator = 0;
+}
@@ -0,0 +1,25 @@
+#ifndef __SIMULATIONCLOCK_H__
+#define __SIMULATIONCLOCK_H__
+
+// Header for SimulationClock of Spirograph program.
+// Turns the wall time between frames into a whole number of fixed
+// simulation steps. Time that does not make up a full step is carried
+// over to the next frame; the fraction of a step it represents is used to
+// interpolate between the last two simulated states when rendering.
+
+class SimulationClock
+{
+public:
+    SimulationClock(double step, double maxElapsed);
+    int advance(double elapsed); // adds wall time, returns the number of steps to simulate
+    double getAlpha(); // leftover time as a fraction of a step, in [0,1)
+    double getStep(); // length of one step in seconds
+    void reset(); // drops leftover time, e.g. while paused
+
+private:
+    double step; // length of one step in seconds
+    double maxElapsed; // longest frame accounted for, so a stall cannot queue up many steps
+    double accumulator; // time not yet simulated
+};
+
+#endif
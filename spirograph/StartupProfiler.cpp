@@ -0,0 +1,72 @@
+#include "StartupProfiler.h"
+#include <cstdio>
+#include <cstdlib>
+#include "spdlog/spdlog.h"
+
+// Implementation of StartupProfiler of Program.
+
+vector<StartupProfiler::Span> StartupProfiler::spans;
+bool StartupProfiler::finished = false;
+
+// the time all spans are measured from, taken during static initialization
+static const chrono::steady_clock::time_point programStart = chrono::steady_clock::now();
+
+// output file, NULL if profiling is disabled
+static const char *traceFile = getenv("SPIROGRAPH_STARTUP_TRACE");
+
+// true if SPIROGRAPH_STARTUP_TRACE is set
+bool StartupProfiler::isEnabled() {
+    return traceFile != NULL && !finished;
+}
+
+// microseconds since the program started
+double StartupProfiler::now() {
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - programStart).count();
+}
+
+// starts a span, returns its id
+int StartupProfiler::beginSpan(const char *name) {
+    if (!isEnabled()) {
+        return -1;
+    }
+    Span span;
+    span.name = name;
+    span.start = now();
+    span.duration = -1;
+    spans.push_back(span);
+    return spans.size() - 1;
+}
+
+// ends the span started with id
+void StartupProfiler::endSpan(int id) {
+    if (id < 0 || finished) {
+        return;
+    }
+    spans[id].duration = now() - spans[id].start;
+}
+
+// called after the first frame, writes the trace file
+// spans that are still open (e.g. main) end here
+void StartupProfiler::finish() {
+    if (!isEnabled()) {
+        return;
+    }
+    double end = now();
+    FILE *out = fopen(traceFile, "w");
+    if (out == NULL) {
+        spdlog::error("Could not write startup trace to {}", traceFile);
+        finished = true;
+        return;
+    }
+    fprintf(out, "{\"traceEvents\":[\n");
+    for (unsigned int i = 0; i < spans.size(); i++) {
+        double duration = spans[i].duration >= 0 ? spans[i].duration : end - spans[i].start;
+        fprintf(out, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1}%s\n",
+            spans[i].name, spans[i].start, duration, i + 1 < spans.size() ? "," : "");
+    }
+    fprintf(out, "],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(out);
+    spdlog::info("Time to first frame {:.1f} ms, startup trace written to {}", end / 1000.0, traceFile);
+    finished = true;
+    spans.clear();
+}
@@ -0,0 +1,45 @@
+#ifndef __STARTUPPROFILER_H__
+#define __STARTUPPROFILER_H__
+
+#include <string>
+#include <vector>
+#include <chrono>
+using namespace std;
+
+// Header for StartupProfiler of Spirograph program.
+// Records how long each startup phase takes until the first frame is shown.
+// Only active when SPIROGRAPH_STARTUP_TRACE names the file to write the spans
+// to, in Chrome trace-event JSON (open it in chrome://tracing or Perfetto).
+// Spans are recorded from the main thread only.
+
+class StartupProfiler
+{
+public:
+    static bool isEnabled(); // true if SPIROGRAPH_STARTUP_TRACE is set
+    static int beginSpan(const char *name); // starts a span, returns its id
+    static void endSpan(int id); // ends the span started with id
+    static void finish(); // called after the first frame, writes the trace file
+
+private:
+    struct Span {
+        const char *name; // phase name, a string literal
+        double start; // microseconds since the program started
+        double duration; // microseconds
+    };
+    static double now(); // microseconds since the program started
+    static vector<Span> spans; // recorded spans in start order
+    static bool finished; // true once the trace file has been written
+};
+
+// Records a span for the lifetime of the enclosing scope.
+class StartupSpan
+{
+public:
+    StartupSpan(const char *name) { id = StartupProfiler::beginSpan(name); }
+    ~StartupSpan() { StartupProfiler::endSpan(id); }
+
+private:
+    int id; // span id, -1 if profiling is disabled
+};
+
+#endif
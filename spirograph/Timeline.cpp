@@ -0,0 +1,221 @@
+#include "Timeline.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <thread>
+#include "spdlog/spdlog.h"
+#include "Trace.h"
+
+// Implementation of Timeline of Program.
+
+static bool isEarlier(const Keyframe& a, const Keyframe& b) {
+    return a.time < b.time;
+}
+
+Timeline::Timeline() {
+    frameRate = TIMELINE_FRAME_RATE;
+}
+
+// reads keyframes from a text file
+bool Timeline::load(const char *file, Timeline& timeline) {
+    FILE *in = fopen(file, "r");
+    if (in == NULL) {
+        spdlog::error("Could not open {} to read a timeline", file);
+        return false;
+    }
+    char line[256];
+    int lineNumber = 0;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        lineNumber++;
+        char first;
+        if (sscanf(line, " %c", &first) != 1 || first == '#') {
+            continue;
+        }
+        Keyframe keyframe;
+        char interpolation[16] = "linear";
+        int count = sscanf(line, "%lf %lf %lf %15s", &keyframe.time, &keyframe.smallRadius,
+                           &keyframe.penOffset, interpolation);
+        if (count < 3 || keyframe.time < 0) {
+            spdlog::error("{}:{} is not a keyframe", file, lineNumber);
+            fclose(in);
+            return false;
+        }
+        if (strcmp(interpolation, "step") == 0) {
+            keyframe.interpolation = Keyframe::STEP;
+        }
+        else if (strcmp(interpolation, "smooth") == 0) {
+            keyframe.interpolation = Keyframe::SMOOTH;
+        }
+        else if (strcmp(interpolation, "linear") == 0) {
+            keyframe.interpolation = Keyframe::LINEAR;
+        }
+        else {
+            spdlog::error("{}:{} has an unknown interpolation {}", file, lineNumber, interpolation);
+            fclose(in);
+            return false;
+        }
+        timeline.addKeyframe(keyframe);
+    }
+    fclose(in);
+    if (timeline.keyframes.empty()) {
+        spdlog::error("{} holds no keyframes", file);
+        return false;
+    }
+    return true;
+}
+
+// kept in order of time, after any keyframe at the same time
+void Timeline::addKeyframe(const Keyframe& keyframe) {
+    keyframes.insert(upper_bound(keyframes.begin(), keyframes.end(), keyframe, isEarlier), keyframe);
+}
+
+// time of the last keyframe
+double Timeline::getDuration() const {
+    return keyframes.empty() ? 0 : keyframes.back().time;
+}
+
+// radius and pen offset at time t, before rounding; the first keyframe's
+// values before it and the last one's after it
+void Timeline::evaluate(double t, double& smallRadius, double& penOffset) const {
+    Keyframe probe;
+    probe.time = t;
+    vector<Keyframe>::const_iterator next = upper_bound(keyframes.begin(), keyframes.end(), probe, isEarlier);
+    if (next == keyframes.begin() || next == keyframes.end()) {
+        const Keyframe& only = next == keyframes.begin() ? keyframes.front() : keyframes.back();
+        smallRadius = only.smallRadius;
+        penOffset = only.penOffset;
+        return;
+    }
+    const Keyframe& previous = *(next - 1);
+    double u = (t - previous.time) / (next->time - previous.time);
+    if (previous.interpolation == Keyframe::STEP) {
+        u = 0;
+    }
+    else if (previous.interpolation == Keyframe::SMOOTH) {
+        u = u * u * (3 - 2 * u);
+    }
+    smallRadius = previous.smallRadius + (next->smallRadius - previous.smallRadius) * u;
+    penOffset = previous.penOffset + (next->penOffset - previous.penOffset) * u;
+}
+
+// Every frame becomes the key of the curve it needs, with the radius
+// rounded and the pen offsets to TIMELINE_OFFSET_STEP, so that frames
+// which only differ by less than that share a curve. The distinct keys are
+// then made in parallel, each worker taking the next one not taken yet,
+// until they are all made or take more than maxBytes between them.
+bool Timeline::plan(Model *model, double frameRate, int threads, size_t maxBytes) {
+    TRACE_SCOPE("Timeline::plan");
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    this->frameRate = frameRate;
+    CurveKey base = model->getCurveKey();
+    int frameCount = (int) floor(getDuration() * frameRate) + 1;
+    map<CurveKey, int> distinct;
+    vector<CurveKey> keys;
+    frameCurves.resize(frameCount);
+    for (int frame = 0; frame < frameCount; frame++) {
+        double radius, shift;
+        evaluate(frame / frameRate, radius, shift);
+        CurveKey key = base;
+        if (base.fourierCurve) {
+            // the radius and pens make no difference to a Fourier curve
+            frameCurves[frame] = 0;
+            if (keys.empty()) {
+                keys.push_back(key);
+            }
+            continue;
+        }
+        key.smallRadius = min(max((int) lround(radius), MIN_SMALL_RADIUS), MAX_SMALL_RADIUS);
+        for (unsigned int i = 0; i < key.penOffsets.size(); i++) {
+            double offset = max(base.penOffsets[i] + shift, 0.0);
+            key.penOffsets[i] = round(offset / TIMELINE_OFFSET_STEP) * TIMELINE_OFFSET_STEP;
+        }
+        map<CurveKey, int>::iterator found = distinct.find(key);
+        if (found == distinct.end()) {
+            found = distinct.insert(make_pair(key, (int) keys.size())).first;
+            keys.push_back(key);
+        }
+        frameCurves[frame] = found->second;
+    }
+
+    // the models are made here, on the calling thread, as making one records startup spans
+    spdlog::info("Timeline: {} frames need {} distinct curves, making them within {:.0f} MiB",
+        frameCount, keys.size(), maxBytes / 1048576.0);
+    threads = max(min(threads, (int) keys.size()), 1);
+    vector<unique_ptr<Model> > workers;
+    for (int i = 0; i < threads; i++) {
+        workers.push_back(unique_ptr<Model>(new Model()));
+        workers.back()->setSamplingThreads(1); // the workers already take every core between them
+    }
+    curves.assign(keys.size(), shared_ptr<const CurveData>());
+    std::atomic<int> next(0);
+    std::atomic<size_t> bytes(0);
+    vector<std::thread> pool;
+    for (int i = 1; i < threads; i++) {
+        pool.push_back(std::thread(&Timeline::makeCurves, workers[i].get(), &keys, &curves, &next,
+                                   &bytes, maxBytes));
+    }
+    makeCurves(workers[0].get(), &keys, &curves, &next, &bytes, maxBytes);
+    for (unsigned int i = 0; i < pool.size(); i++) {
+        pool[i].join();
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (bytes.load() > maxBytes) {
+        int made = 0;
+        for (unsigned int i = 0; i < curves.size(); i++) {
+            made = made + (curves[i] ? 1 : 0);
+        }
+        spdlog::error("Timeline: {} of {} curves already take {:.1f} MiB, more than {:.0f} MiB; not played "
+            "(shorten it, change the offset in steps, or raise SPIROGRAPH_TIMELINE_MEMORY)",
+            made, curves.size(), bytes.load() / 1048576.0, maxBytes / 1048576.0);
+        curves.clear();
+        frameCurves.clear();
+        return false;
+    }
+    spdlog::info("Timeline: {} curves ({:.1f} MiB) made in {:.2f} s on {} threads",
+        curves.size(), bytes.load() / 1048576.0, seconds, threads);
+    return true;
+}
+
+// makes curves[i] for every i taken from next, on a model of its own,
+// adding up their memory in bytes and taking no more once it passes maxBytes
+void Timeline::makeCurves(Model *worker, const vector<CurveKey> *keys,
+                          vector<shared_ptr<const CurveData> > *curves, std::atomic<int> *next,
+                          std::atomic<size_t> *bytes, size_t maxBytes) {
+    for (int i = next->fetch_add(1); i < (int) keys->size() && bytes->load() <= maxBytes; i = next->fetch_add(1)) {
+        worker->setCurveKey((*keys)[i]);
+        (*curves)[i] = worker->makeCurve();
+        bytes->fetch_add((*curves)[i]->bytes);
+    }
+}
+
+bool Timeline::isPlanned() const {
+    return !frameCurves.empty();
+}
+
+int Timeline::getFrameCount() const {
+    return frameCurves.size();
+}
+
+// frame shown at time t, the last one after the end
+int Timeline::getFrameAt(double t) const {
+    int frame = (int) floor(t * frameRate + 1e-9);
+    return min(max(frame, 0), (int) frameCurves.size() - 1);
+}
+
+// the curve of a frame, made by plan
+const shared_ptr<const CurveData>& Timeline::getFrameCurve(int frame) const {
+    return curves[frameCurves[frame]];
+}
+
+// distinct curves of all frames
+int Timeline::getCurveCount() const {
+    return curves.size();
+}
+
+const shared_ptr<const CurveData>& Timeline::getCurve(int i) const {
+    return curves[i];
+}
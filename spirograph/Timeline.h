@@ -0,0 +1,77 @@
+#ifndef __TIMELINE_H__
+#define __TIMELINE_H__
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "Model.h"
+using namespace std;
+
+// Header for Timeline of Spirograph program.
+// Keyframes of the inner radius and the pen offset over time, for renders
+// scripted ahead of time. Planning samples the timeline once per frame,
+// finds the frames that need the same curve, and makes every distinct
+// curve once, on models of its own on all cores. Playing back then only
+// looks up the curve of a frame, so no frame waits for a regeneration.
+// All the curves are held at once, so planning gives up once they take
+// more memory than it is allowed.
+
+#define TIMELINE_FRAME_RATE 60 // frames per second the timeline is planned for, unless set
+#define TIMELINE_OFFSET_STEP 0.001 // pen offsets closer than this make the same curve
+#define TIMELINE_CURVE_BYTES (512LL << 20) // memory the curves of a timeline may take, unless set
+
+// The parameters at one time, and how to get from here to the next keyframe.
+struct Keyframe {
+    enum Interpolation {
+        STEP, // holds these values until the next keyframe
+        LINEAR,
+        SMOOTH // eases in and out
+    };
+    double time; // seconds from the start of the timeline
+    double smallRadius; // rounded to a whole radius in each frame
+    double penOffset; // added to the offset of every pen, as a fraction of the radius, like "D"
+    Interpolation interpolation;
+};
+
+class Timeline
+{
+public:
+    Timeline();
+
+    // lines of "time radius penOffset [step|linear|smooth]" (linear unless
+    // given), "#" starting a comment; false if the file cannot be read
+    static bool load(const char *file, Timeline& timeline);
+
+    void addKeyframe(const Keyframe& keyframe); // kept in order of time
+    double getDuration() const; // time of the last keyframe
+
+    // radius and pen offset at time t, before rounding
+    void evaluate(double t, double& smallRadius, double& penOffset) const;
+
+    // Samples every frame at frameRate and makes the distinct curves on
+    // threads threads, the model's other parameters staying as they are.
+    // Called before the model is handed to the simulation. False, leaving
+    // the timeline unplanned, if the curves take more than maxBytes.
+    bool plan(Model *model, double frameRate, int threads, size_t maxBytes);
+
+    bool isPlanned() const;
+    int getFrameCount() const;
+    int getFrameAt(double t) const; // frame shown at time t, the last one after the end
+    const shared_ptr<const CurveData>& getFrameCurve(int frame) const; // made by plan
+    int getCurveCount() const; // distinct curves of all frames
+    const shared_ptr<const CurveData>& getCurve(int i) const;
+
+private:
+    vector<Keyframe> keyframes;
+    double frameRate;
+    vector<shared_ptr<const CurveData> > curves; // the distinct curves
+    vector<int> frameCurves; // index into curves of every frame
+
+    // makes curves[i] for every i taken from next, on a model of its own,
+    // adding up their memory in bytes and taking no more once it passes maxBytes
+    static void makeCurves(Model *worker, const vector<CurveKey> *keys,
+                           vector<shared_ptr<const CurveData> > *curves, std::atomic<int> *next,
+                           std::atomic<size_t> *bytes, size_t maxBytes);
+};
+
+#endif
@@ -0,0 +1,143 @@
+#include "Trace.h"
+
+#ifdef SPIROGRAPH_TRACING
+
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include "spdlog/spdlog.h"
+#include "spdlog/sinks/basic_file_sink.h"
+
+// Implementation of scoped tracing of Program.
+
+std::atomic<bool> Tracer::running(false);
+
+static std::mutex ringsMutex; // guards rings, taken once per thread and per drain pass
+static std::vector<std::unique_ptr<TraceRing> > rings; // at most one per thread tracing at the same time
+static std::vector<TraceRing *> freeRings; // drained rings of exited threads, for the next new thread
+
+static std::shared_ptr<spdlog::logger> traceLogger; // writes the trace file
+static std::thread drainThread;
+static std::mutex drainMutex;
+static std::condition_variable drainWakeup;
+static bool draining = false; // guarded by drainMutex
+
+// timestamps are written relative to when start() was called
+static uint64_t startTicks;
+static std::chrono::steady_clock::time_point startTime;
+
+// registers a ring for the calling thread, or reuses a reclaimed one
+TraceRing *Tracer::createRing() {
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    if (!freeRings.empty()) {
+        TraceRing *ring = freeRings.back();
+        freeRings.pop_back();
+        return ring;
+    }
+    rings.push_back(std::unique_ptr<TraceRing>(new TraceRing(rings.size() + 1)));
+    return rings.back().get();
+}
+
+// ticks per microsecond, measured over the time since start()
+static double ticksPerMicrosecond() {
+    uint64_t ticks = Tracer::ticks() - startTicks;
+    double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+    return micros > 0 ? ticks / micros : 1.0;
+}
+
+// moves every event recorded so far into the trace file, and reclaims the
+// rings of threads that have exited once they are empty
+static void drainRings() {
+    std::vector<TraceRing *> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        for (unsigned int i = 0; i < rings.size(); i++) {
+            snapshot.push_back(rings[i].get());
+        }
+    }
+
+    double scale = 1.0 / ticksPerMicrosecond();
+    TraceEvent batch[256];
+    for (unsigned int i = 0; i < snapshot.size(); i++) {
+        bool released = snapshot[i]->isReleased();
+        uint32_t n;
+        while ((n = snapshot[i]->pop(batch, 256)) > 0) {
+            for (uint32_t j = 0; j < n; j++) {
+                traceLogger->info("{{\"name\":\"{}\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":1,\"tid\":{}}},",
+                    batch[j].name, (int64_t)(batch[j].begin - startTicks) * scale,
+                    (batch[j].end - batch[j].begin) * scale, snapshot[i]->getThreadId());
+            }
+        }
+        if (released) {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            snapshot[i]->reclaim();
+            freeRings.push_back(snapshot[i]);
+        }
+    }
+}
+
+// opens the trace file and starts the drain thread
+void Tracer::start() {
+    const char *file = getenv("SPIROGRAPH_TRACE_FILE");
+    if (file == NULL) {
+        file = "spirograph_trace.json";
+    }
+    try {
+        auto sink = std::make_shared<spdlog::sinks::basic_file_sink_st>(file, true);
+        // not registered, so SPDLOG_LEVEL does not silence the trace file
+        traceLogger = std::make_shared<spdlog::logger>("trace", sink);
+    }
+    catch (const spdlog::spdlog_ex &e) {
+        spdlog::error("Tracing disabled: {}", e.what());
+        return;
+    }
+    traceLogger->set_pattern("%v");
+    traceLogger->set_level(spdlog::level::info);
+    traceLogger->info("{}", "[");
+
+    startTicks = ticks();
+    startTime = std::chrono::steady_clock::now();
+    draining = true;
+    drainThread = std::thread([]() {
+        std::unique_lock<std::mutex> lock(drainMutex);
+        while (draining) {
+            drainWakeup.wait_for(lock, std::chrono::milliseconds(10));
+            drainRings();
+        }
+    });
+    running.store(true);
+    spdlog::info("Tracing to {}", file);
+}
+
+// drains everything left and closes the trace file
+void Tracer::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(drainMutex);
+        draining = false;
+    }
+    drainWakeup.notify_all();
+    drainThread.join();
+    drainRings();
+
+    uint64_t dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        for (unsigned int i = 0; i < rings.size(); i++) {
+            dropped += rings[i]->getDropped();
+        }
+    }
+    traceLogger->info("{}", "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"spirograph\"}}]");
+    traceLogger->flush();
+    traceLogger.reset();
+    if (dropped > 0) {
+        spdlog::warn("Tracing dropped {} events, trace buffers were full", dropped);
+    }
+}
+
+#endif
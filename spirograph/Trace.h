@@ -0,0 +1,168 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+// Header for scoped tracing of hot paths in Spirograph program.
+//
+// TRACE_SCOPE("name") records when the enclosing scope starts and ends.
+// Records go into a lock-free ring buffer owned by the calling thread, and a
+// background thread drains all buffers into a Chrome trace-event file
+// (SPIROGRAPH_TRACE_FILE, default spirograph_trace.json) through spdlog.
+// If a buffer is full, records are dropped rather than making the traced
+// thread wait; the count of dropped records is logged at the end. When a
+// thread exits, its buffer is drained and then handed to the next new thread,
+// so short-lived worker threads do not each keep a buffer for the whole run.
+//
+// Tracing only exists when built with SPIROGRAPH_TRACING defined
+// (make TRACING=1). Otherwise the macros expand to nothing.
+
+#ifdef SPIROGRAPH_TRACING
+
+#include <atomic>
+#include <cstdint>
+#include <chrono>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <x86intrin.h>
+#endif
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_START() Tracer::start()
+#define TRACE_STOP() Tracer::stop()
+
+// One traced scope: name and start/end timestamps in Tracer::ticks().
+struct TraceEvent {
+    const char *name; // must be a string literal
+    uint64_t begin;
+    uint64_t end;
+};
+
+// Single-producer single-consumer ring of events for one thread.
+// Only the owning thread pushes and only the drain thread pops.
+class TraceRing
+{
+public:
+    static const uint32_t CAPACITY = 1 << 14; // events, a power of two
+
+    TraceRing(uint32_t threadId) : cachedTail(0), head(0), tail(0), dropped(0), released(false), threadId(threadId) {}
+
+    // called on the owning thread, never blocks
+    void push(const char *name, uint64_t begin, uint64_t end) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - cachedTail == CAPACITY) {
+            // only look at the consumer's cache line when the ring looks full
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h - cachedTail == CAPACITY) {
+                dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        TraceEvent &e = events[h & (CAPACITY - 1)];
+        e.name = name;
+        e.begin = begin;
+        e.end = end;
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    // called on the drain thread, copies out up to max events and returns how many
+    uint32_t pop(TraceEvent *out, uint32_t max) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        uint32_t h = head.load(std::memory_order_acquire);
+        uint32_t n = 0;
+        while (t != h && n < max) {
+            out[n++] = events[t & (CAPACITY - 1)];
+            t++;
+        }
+        tail.store(t, std::memory_order_release);
+        return n;
+    }
+
+    uint64_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+    uint32_t getThreadId() const { return threadId; }
+
+    // called on the owning thread as it exits, after its last push
+    void release() { released.store(true, std::memory_order_release); }
+    // called on the drain thread, true once the owner has exited; checked
+    // before draining, so that every event the owner pushed gets drained
+    bool isReleased() const { return released.load(std::memory_order_acquire); }
+    // called on the drain thread once the ring is empty, to give it to a new thread
+    void reclaim() { released.store(false, std::memory_order_relaxed); }
+
+private:
+    TraceEvent events[CAPACITY];
+    uint32_t cachedTail; // producer's last view of tail
+    alignas(64) std::atomic<uint32_t> head; // next slot to write, owned by the producer
+    alignas(64) std::atomic<uint32_t> tail; // next slot to read, owned by the drain thread
+    std::atomic<uint64_t> dropped; // events lost because the ring was full
+    std::atomic<bool> released; // the owning thread has exited
+    uint32_t threadId; // small sequential id used as tid in the trace
+};
+
+class Tracer
+{
+public:
+    static void start(); // opens the trace file and starts the drain thread
+    static void stop(); // drains everything left and closes the trace file
+
+    // true between start() and stop()
+    static bool isRunning() { return running.load(std::memory_order_relaxed); }
+
+    // cheap monotonic timestamp, converted to microseconds when drained
+    static uint64_t ticks() {
+#if defined(__x86_64__) || defined(_M_X64)
+        return __rdtsc();
+#else
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+
+    // the ring of the calling thread, created (or reused) on first use
+    static TraceRing *threadRing() {
+        static thread_local RingOwner owner;
+        if (owner.ring == NULL) {
+            owner.ring = createRing();
+        }
+        return owner.ring;
+    }
+
+private:
+    // releases the ring of a thread when the thread exits
+    struct RingOwner {
+        TraceRing *ring;
+        RingOwner() : ring(NULL) {}
+        ~RingOwner() {
+            if (ring != NULL) {
+                ring->release();
+            }
+        }
+    };
+
+    static TraceRing *createRing(); // registers a ring for the calling thread, or reuses a reclaimed one
+    static std::atomic<bool> running;
+};
+
+// Records one event covering its own lifetime.
+class TraceScope
+{
+public:
+    TraceScope(const char *name) : name(name), begin(Tracer::isRunning() ? Tracer::ticks() : 0) {}
+    ~TraceScope() {
+        if (begin != 0) {
+            Tracer::threadRing()->push(name, begin, Tracer::ticks());
+        }
+    }
+
+private:
+    const char *name;
+    uint64_t begin; // 0 if the tracer was not running when the scope started
+};
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_START() ((void)0)
+#define TRACE_STOP() ((void)0)
+
+#endif
+
+#endif
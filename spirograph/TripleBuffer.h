@@ -0,0 +1,45 @@
+#ifndef __TRIPLEBUFFER_H__
+#define __TRIPLEBUFFER_H__
+
+#include <atomic>
+
+// Header for TripleBuffer of Spirograph program.
+// Hands the latest value from one writer thread to one reader thread
+// without locks. The writer fills its back slot and swaps it with the
+// middle slot; the reader swaps the middle slot with its front slot when
+// something new was published there. Neither thread ever waits for the
+// other, the reader always sees a whole value, and values published while
+// the reader was busy are overwritten by newer ones.
+
+template <class T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() : middle(1), back(2), front(0) {}
+
+    // called on the writer thread, replaces the published value
+    void write(const T& value) {
+        slots[back] = value;
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // called on the reader thread, the latest published value
+    // (the same one as last time if nothing was published since)
+    const T& read() {
+        if (middle.load(std::memory_order_relaxed) & FRESH) {
+            front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        }
+        return slots[front];
+    }
+
+private:
+    static const int INDEX = 3; // bits of middle holding the slot index
+    static const int FRESH = 4; // set in middle until the reader takes it
+
+    T slots[3];
+    alignas(64) std::atomic<int> middle; // slot between the threads
+    alignas(64) int back; // slot being written, owned by the writer
+    alignas(64) int front; // slot being read, owned by the reader
+};
+
+#endif
@@ -44,29 +44,30 @@ public:
     vector<float> getData(string attribName)
     {
         vector<float> result;
-        stringstream message;
-
+        copyData(attribName,result);
+        return result;
+    }
 
+    void copyData(string attribName, vector<float>& data)
+    {
         if (attribName == "position")
         {
-            result.push_back(position.x);
-            result.push_back(position.y);
-            result.push_back(position.z);
-            result.push_back(position.w);
+            data.resize(4);
+            data[0] = position.x;
+            data[1] = position.y;
+            data[2] = position.z;
+            data[3] = position.w;
         }
         else
         {
+            stringstream message;
             message << "No attribute: " << attribName << " found!";
             throw runtime_error(message.str());
         }
-
-        return result;
     }
 
     void setData(string attribName, const vector<float>& data) 
     {
-        stringstream message;
-
         if (attribName == "position")
         {
             position = glm::vec4(0,0,0,1);
@@ -77,12 +78,16 @@ public:
             case 1: position.x = data[0];
                 break;
             default:
-                message << "Too much data for attribute: " << attribName;
-                throw runtime_error(message.str());
+                {
+                    stringstream message;
+                    message << "Too much data for attribute: " << attribName;
+                    throw runtime_error(message.str());
+                }
             }
         }       
         else
         {
+            stringstream message;
             message << "Attribute: " << attribName << " unsupported!";
             throw runtime_error(message.str());
         }
@@ -1,9 +1,15 @@
 #include <iostream>
+#include <cstdlib>
+#include <thread>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include "spdlog/spdlog.h"
 #include "View.h"
+#include "shaders/DefaultShaders.h"
+#include "StartupProfiler.h"
+#include "Trace.h"
+#include "AllocationTracker.h"
 
 // Implementation of View of Program.
 
@@ -15,25 +21,65 @@ static void error_callback(int error, const char* description)
     fprintf(stderr, "Error: %s\n", description);
 }
 
-View::View() {
+// frees the GPU buffers of an object once nothing uses it any more
+static void deleteObject(util::ObjectInstance *object) {
+    object->cleanup();
+    delete object;
+}
+
+// GPU memory of an uploaded curve mesh: 4 floats per vertex and one index per primitive
+static size_t uploadBytes(const util::PolygonMesh<VertexAttrib>& mesh) {
+    return mesh.getVertexCount() * 4 * sizeof(float) + mesh.getPrimitiveCount() * sizeof(GLuint);
+}
+
+// reads gears such as "i100,o40": each a radius, after "o" if it rolls
+// around the outside of the gear before it and optionally "i" if inside
+static vector<Gear> parseGears(const char *text) {
+    vector<Gear> gears;
+    const char *next = text;
+    while (*next != '\0') {
+        Gear gear;
+        gear.outside = (*next == 'o' || *next == 'O');
+        if (gear.outside || *next == 'i' || *next == 'I') {
+            next++;
+        }
+        char *end;
+        gear.radius = (int) strtol(next, &end, 10);
+        if (end == next) {
+            next++; // skips a separator
+            continue;
+        }
+        next = end;
+        if (gear.radius <= 0) {
+            spdlog::warn("Gear of radius {} left out", gear.radius);
+            continue;
+        }
+        gears.push_back(gear);
+    }
+    return gears;
+}
+
+View::View() : gpuCurveCache(GPU_CURVE_CACHE_BYTES) {
     int sections = 200;
     curveColor = glm::vec4(0.431,0.780,0.408,1);
-    showCurve = true; // initially show curve
 }
 
 View::~View(){
 }
 
 // sets up the View for the program
-int View::init(Model* m)
+int View::init(Model* m, Simulation* s)
 {
     // save the model and controller
     this->model = m;
+    this->simulation = s;
 
     glfwSetErrorCallback(error_callback);
 
+    int span = StartupProfiler::beginSpan("glfwInit");
     if (!glfwInit())
         exit(EXIT_FAILURE);
+    StartupProfiler::endSpan(span);
 
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -42,7 +88,9 @@ int View::init(Model* m)
     
     window_dimensions = glm::vec2(800,800);
 
+    span = StartupProfiler::beginSpan("glfwCreateWindow");
     window = glfwCreateWindow(window_dimensions.x,window_dimensions.y, "Spirograph", NULL, NULL);
+    StartupProfiler::endSpan(span);
     if (!window)
     {
         glfwTerminate();
@@ -57,36 +105,234 @@ int View::init(Model* m)
     {
         static_cast<View*>(glfwGetWindowUserPointer(window))->onkey(window,key,scancode,action,mods);
     });
+    glfwSetScrollCallback(window,
+    [](GLFWwindow* window, double xoffset, double yoffset)
+    {
+        static_cast<View*>(glfwGetWindowUserPointer(window))->onscroll(window,xoffset,yoffset);
+    });
 
     glfwMakeContextCurrent(window);
+    span = StartupProfiler::beginSpan("gladLoadGLLoader");
     gladLoadGLLoader((GLADloadproc)glfwGetProcAddress); // loading Glad
+    StartupProfiler::endSpan(span);
     glfwSwapInterval(1);
 
-    // create the shader program
-    program.createProgram(string("shaders/default.vert"),
-                          string("shaders/default.frag"));
+    // SPIROGRAPH_RECORD saves key events to a file, SPIROGRAPH_REPLAY plays such a
+    // file back at the same frames, without vsync so the session runs as fast as it can
+    const char *recordFile = getenv("SPIROGRAPH_RECORD");
+    const char *replayFile = getenv("SPIROGRAPH_REPLAY");
+    if (replayFile != NULL) {
+        if (input.startReplay(replayFile)) {
+            glfwSwapInterval(0);
+        }
+    }
+    else if (recordFile != NULL) {
+        input.startRecording(recordFile);
+    }
+
+    // create the shader program from the sources embedded in the binary,
+    // or from SPIROGRAPH_SHADER_DIR when set (for editing shaders without rebuilding)
+    // SPIROGRAPH_SHADER_CACHE names a directory to keep linked program binaries in
+    span = StartupProfiler::beginSpan("shader compile/link");
+    const char *shaderDir = getenv("SPIROGRAPH_SHADER_DIR");
+    const char *shaderCache = getenv("SPIROGRAPH_SHADER_CACHE");
+    if (shaderCache != NULL) {
+        program.setBinaryCacheDirectory(shaderCache, (GLADloadproc) glfwGetProcAddress);
+    }
+    if (shaderDir != NULL) {
+        spdlog::info("Loading shaders from {}", shaderDir);
+        program.createProgram(string(shaderDir) + "/default.vert",
+                              string(shaderDir) + "/default.frag");
+        // recompile whenever the files are saved, see display()
+        program.watchSourceFiles();
+    }
+    else {
+        program.createProgramFromSource(DEFAULT_VERT_SHADER, DEFAULT_FRAG_SHADER);
+    }
+    if (program.isFromBinaryCache()) {
+        spdlog::debug("Shader program loaded from binary cache {}", shaderCache);
+    }
     // assuming it got created, get all the shader variables that it uses
     // so we can initialize them at some point
     // enable the shader program
     program.enable();
     shaderLocations = program.getAllShaderVariables();
+    StartupProfiler::endSpan(span);
 
     shaderVarsToVertexAttribs["vPosition"] = "position";
     
-    innerCircAngle = 0.0;
-    innerCircRotAngle = 0.0;
-    savedInnerCircAngle = 0.0;
-    savedInnerCircRotAngle = 0.0;
+    //prepare the projection matrix for orthographic projection
+    viewCentre = glm::vec2(0,0);
+    zoom = 1;
+    updateProjection();
+
+    // the simulation thread is not running yet, so the model can be used here
+    // sample the curve so that it strays at most SPIROGRAPH_PIXEL_TOLERANCE pixels
+    // (default 0.25) from the true curve; 0 samples at the old fixed step
+    double pixelTolerance = 0.25;
+    const char *toleranceValue = getenv("SPIROGRAPH_PIXEL_TOLERANCE");
+    if (toleranceValue != NULL) {
+        pixelTolerance = atof(toleranceValue);
+    }
+    double unitsPerPixel = (2.0 / projection[0][0]) / window_dimensions.x;
+    baseCurveTolerance = pixelTolerance * unitsPerPixel;
+    toleranceOctave = 0;
+    model->setCurveTolerance(baseCurveTolerance);
+    // coarser copies of the curve for when it covers few pixels, drawn while they stay
+    // within SPIROGRAPH_LOD_PIXEL_ERROR pixels (default 0.5) of the finest one
+    model->setCurveLevelCount(CURVE_LEVELS);
+    // only one lobe of the pattern is made and drawn turned several times,
+    // unless SPIROGRAPH_SYMMETRY=0
+    const char *symmetryValue = getenv("SPIROGRAPH_SYMMETRY");
+    model->setSymmetryInstancing(symmetryValue == NULL || atoi(symmetryValue) != 0);
+    instanceAngle = 0;
+    lodPixelError = 0.5f;
+    const char *lodValue = getenv("SPIROGRAPH_LOD_PIXEL_ERROR");
+    if (lodValue != NULL) {
+        lodPixelError = atof(lodValue);
+    }
+    // SPIROGRAPH_ARC_LENGTH_POINTS respaces the curve to that many points evenly along its length
+    const char *arcLengthPoints = getenv("SPIROGRAPH_ARC_LENGTH_POINTS");
+    if (arcLengthPoints != NULL) {
+        model->setArcLengthPoints(atoi(arcLengthPoints));
+    }
+    // SPIROGRAPH_GEARS sets up gears rolling on the inner circle and on each other,
+    // e.g. "i100,o40": a gear of radius 100 inside it and one of 40 around the outside of that
+    const char *gearsValue = getenv("SPIROGRAPH_GEARS");
+    if (gearsValue != NULL) {
+        model->setNestedGears(parseGears(gearsValue));
+    }
+    // SPIROGRAPH_FOURIER names a file of Fourier coefficients or of a closed polyline to
+    // fit SPIROGRAPH_FOURIER_TERMS terms to (default 512), drawn instead of the circles' curve
+    const char *fourierFile = getenv("SPIROGRAPH_FOURIER");
+    if (fourierFile != NULL) {
+        const char *termsValue = getenv("SPIROGRAPH_FOURIER_TERMS");
+        int terms = termsValue != NULL ? atoi(termsValue) : 512;
+        FourierCurve fourier;
+        if (FourierCurve::load(fourierFile, terms, model->getBigCircRadius(), fourier)) {
+            model->setFourierCurve(make_shared<const FourierCurve>(fourier));
+        }
+    }
+    // SPIROGRAPH_RING_SHAPE and SPIROGRAPH_GEAR_SHAPE roll a gear of another
+    // outline than a circle, each "circle:r", "ellipse:a,b" or a file of "x y" lines
+    const char *ringShapeValue = getenv("SPIROGRAPH_RING_SHAPE");
+    Shape shape;
+    if (ringShapeValue != NULL && Shape::parse(ringShapeValue, shape)) {
+        if (!shape.isConvex()) {
+            spdlog::warn("{} is not convex, the gear may cut through the ring", ringShapeValue);
+        }
+        model->setRingShape(make_shared<const Shape>(shape));
+    }
+    const char *gearShapeValue = getenv("SPIROGRAPH_GEAR_SHAPE");
+    if (gearShapeValue != NULL && Shape::parse(gearShapeValue, shape)) {
+        if (!shape.isConvex()) {
+            spdlog::warn("{} is not convex, the gear may cut through the ring", gearShapeValue);
+        }
+        model->setGearShape(make_shared<const Shape>(shape));
+    }
+    // the curve being waited for is sampled on every core
+    model->setSamplingThreads(std::thread::hardware_concurrency());
+    // SPIROGRAPH_PEN_OFFSETS puts pens at these fractions of the inner radius
+    // from its centre, e.g. "0.25,0.5,0.75" (default one pen at 0.5)
+    const char *penOffsetsValue = getenv("SPIROGRAPH_PEN_OFFSETS");
+    if (penOffsetsValue != NULL) {
+        vector<double> offsets;
+        char *end = (char *) penOffsetsValue;
+        while (*end != '\0') {
+            const char *start = end;
+            double offset = strtod(start, &end);
+            if (end == start) {
+                end++; // skips a separator
+                continue;
+            }
+            offsets.push_back(fabs(offset));
+        }
+        if (offsets.size() > MAX_PENS) {
+            spdlog::warn("Only the first {} of {} pens are drawn", MAX_PENS, offsets.size());
+        }
+        model->setPenOffsets(offsets);
+    }
+    // uploaded curves are kept for when their parameters come back, unless SPIROGRAPH_GPU_CURVE_CACHE=0
+    const char *gpuCacheValue = getenv("SPIROGRAPH_GPU_CURVE_CACHE");
+    gpuCurveCacheEnabled = gpuCacheValue == NULL || atoi(gpuCacheValue) != 0;
+    curveVersion = 0;
+    span = StartupProfiler::beginSpan("first upload");
     vector<util::PolygonMesh<VertexAttrib>> meshes = model->getCircleMesh();
     makeObject(meshes);
-    meshes = model->getCurveMesh();
-    makeObject(meshes);
+    setCurve(model->getCurve());
+    StartupProfiler::endSpan(span);
+
+    // SPIROGRAPH_STREAM=1 draws the trail of the pens as they go, for as long as
+    // they run, keeping the last SPIROGRAPH_STREAM_POINTS points (default 65536)
+    // of every pen in a buffer of fixed size; only for circles and gears
+    const char *streamValue = getenv("SPIROGRAPH_STREAM");
+    streaming = streamValue != NULL && atoi(streamValue) != 0;
+    if (streaming) {
+        int capacity = STREAM_CAPACITY;
+        const char *streamPoints = getenv("SPIROGRAPH_STREAM_POINTS");
+        if (streamPoints != NULL && atoi(streamPoints) > 1) {
+            capacity = atoi(streamPoints);
+        }
+        // every ring starts out as one point at the origin
+        vector<VertexAttrib> vertexData(MAX_PENS * (capacity + 1));
+        vector<float> origin(4, 0.0f);
+        origin[3] = 1.0f;
+        vector<unsigned int> indices(vertexData.size());
+        for (unsigned int i=0;i<vertexData.size();i++) {
+            vertexData[i].setData("position", origin);
+            indices[i] = i;
+        }
+        util::PolygonMesh<VertexAttrib> ring;
+        ring.setVertexData(vertexData);
+        ring.setPrimitives(indices);
+        ring.setPrimitiveType(GL_LINE_STRIP);
+        ring.setPrimitiveSize(2);
+        stream.init(shared_ptr<util::ObjectInstance>(makeObject(ring), deleteObject), capacity);
+    }
+    // SPIROGRAPH_TIMELINE names a file of keyframes of the radius and pen offset,
+    // played back a frame at a time once every curve it needs has been made,
+    // if they fit in SPIROGRAPH_TIMELINE_MEMORY MiB (default 512)
+    const char *timelineFile = getenv("SPIROGRAPH_TIMELINE");
+    size_t timelineBytes = TIMELINE_CURVE_BYTES;
+    const char *timelineMemory = getenv("SPIROGRAPH_TIMELINE_MEMORY");
+    if (timelineMemory != NULL && atoi(timelineMemory) > 0) {
+        timelineBytes = (size_t) atoi(timelineMemory) << 20;
+    }
+    if (timelineFile != NULL && Timeline::load(timelineFile, timeline)
+        && timeline.plan(model, TIMELINE_FRAME_RATE, max((int) std::thread::hardware_concurrency(), 1), timelineBytes)) {
+        simulation->setTimeline(&timeline);
+        // and uploaded ahead while they fit in the GPU curve cache, so playing
+        // them only binds buffers; the model's curve, uploaded above, is counted
+        // as well, so that taking it again below evicts none of them
+        size_t uploaded = gpuCurveCache.getBytes();
+        for (int i=0;gpuCurveCacheEnabled && i<timeline.getCurveCount();i++) {
+            uploaded += uploadBytes(timeline.getCurve(i)->meshes[0]);
+            if (uploaded > GPU_CURVE_CACHE_BYTES) {
+                spdlog::warn("Only {} of {} timeline curves fit in the GPU curve cache", i, timeline.getCurveCount());
+                break;
+            }
+            setCurve(timeline.getCurve(i));
+        }
+        setCurve(model->getCurve());
+    }
 
-    //prepare the projection matrix for orthographic projection
-	projection = glm::ortho(-800.0, 800.0, -800.0, 800.0);
+    // a changed radius or pen offset eases in over SPIROGRAPH_MORPH_SECONDS
+    // (default 0.25), the shader working out the curve of every frame; 0 jumps,
+    // as does a timeline, which eases by its own keyframes, and a replay, whose
+    // frames must not depend on how fast they are drawn
+    double morphSeconds = MORPH_SECONDS;
+    const char *morphValue = getenv("SPIROGRAPH_MORPH_SECONDS");
+    if (morphValue != NULL) {
+        morphSeconds = max(atof(morphValue), 0.0);
+    }
+    morph.init(timeline.isPlanned() || input.isReplaying() ? 0 : morphSeconds);
 
     frames = 0;
     time = glfwGetTime();
+    displayAllocations = 0;
+    frameNumber = 0;
+    advancesPosted = 0;
+    replayStart = time;
 
     //default motion is speed 1 in direction (1,1)
     speed = 1;
@@ -111,17 +357,42 @@ int View::init(Model* m)
      * shader variables will be the same.
        We create such a shader variable -> vertex attribute mapping now
      */
-void View::makeObject(vector<util::PolygonMesh<VertexAttrib> > meshes) {
+void View::makeObject(const vector<util::PolygonMesh<VertexAttrib> >& meshes) {
     for (int i=0;i<meshes.size();i++) {
-        util::ObjectInstance *obj = new util::ObjectInstance("meshes");
-        obj->initPolygonMesh<VertexAttrib>(
-            program,                    // the shader program
-            shaderLocations,            // the shader locations
-            shaderVarsToVertexAttribs,  // the shader variable -> attrib map
-            meshes[i]);                 // the actual mesh object
+        objects.push_back(makeObject(meshes[i]));
+    }
+}
 
-        objects.push_back(obj);
+// creates an object to render one mesh
+util::ObjectInstance *View::makeObject(const util::PolygonMesh<VertexAttrib>& mesh) {
+    ALLOC_PHASE("upload");
+    TRACE_SCOPE("ObjectInstance::initPolygonMesh");
+    util::ObjectInstance *obj = new util::ObjectInstance("meshes");
+    obj->initPolygonMesh<VertexAttrib>(
+        program,                    // the shader program
+        shaderLocations,            // the shader locations
+        shaderVarsToVertexAttribs,  // the shader variable -> attrib map
+        mesh);                      // the actual mesh object
+    return obj;
+}
+
+// draws this curve from now on, uploading it unless it is still in the GPU curve cache
+void View::setCurve(const shared_ptr<const CurveData>& curve) {
+    shared_ptr<util::ObjectInstance> object;
+    if (!gpuCurveCacheEnabled || !gpuCurveCache.get(curve->key, object)) {
+        object = shared_ptr<util::ObjectInstance>(makeObject(curve->meshes[0]), deleteObject);
+        if (gpuCurveCacheEnabled) {
+            gpuCurveCache.put(curve->key, object, uploadBytes(curve->meshes[0]));
+        }
     }
+    // the previous curve is freed here unless the cache holds on to it
+    curveObject = object;
+    curveLevels = curve->levels;
+    curveChunks = curve->chunks;
+    lobeCount = curve->lobeCount;
+    lobeAngle = curve->lobeAngle;
+    penCount = curve->penCount;
+    updateCurveRadius();
 }
 
 void processInput(GLFWwindow *window)
@@ -136,156 +407,174 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 
 // draws the lines based on vertex coordinates, defines circles
 void View::display() {
+    TRACE_SCOPE("View::display");
+
+    // pick up edits to the shader files, only watched when loaded from SPIROGRAPH_SHADER_DIR
+    try {
+        if (program.reloadIfChanged()) {
+            shaderLocations = program.getAllShaderVariables();
+            spdlog::info("Shaders reloaded");
+        }
+    }
+    catch (runtime_error& e) {
+        spdlog::error("Shader reload failed, keeping the old shaders:\n{}", e.what());
+    }
+
+    replayInput();
+    // a replay pretends every frame took exactly as long, so it does the same steps every run,
+    // and a timeline shows each of its frames once; either way the frame waits for its step
+    if (input.isReplaying()) {
+        advanceDriven(REPLAY_FRAME_TIME);
+    }
+    else if (timeline.isPlanned()) {
+        advanceDriven(1.0 / TIMELINE_FRAME_RATE);
+    }
+    const SimulationState& state = simulation->latest();
+    updateCurve(state);
     
     program.enable();
     glClearColor(0,0,0,1);
     glClear(GL_COLOR_BUFFER_BIT);
 
     // draw objects
-    drawDrawingAndInnerCircle();
-    drawOuterCircle();
-    drawCurve();
-    
-    glFlush();
+    {
+        TRACE_SCOPE("View::draw");
+        ALLOC_PHASE("frame display");
+        // a Fourier curve or one of shaped gears is not drawn by circles
+        if (state.drawCircles) {
+            drawDrawingAndInnerCircle(state);
+            drawOuterCircle(state);
+        }
+        // a single inner circle eases between radii, the curve of each frame drawn by the shader
+        double now = glfwGetTime();
+        bool morphable = state.drawCircles && state.train.getGearCount() == 1;
+        if (morphable) {
+            morph.setTarget(state.bigCircRadius, state.smallCircRadius, state.train.getGear(0).outside,
+                            state.penOffsets, state.penCount, now);
+        }
+        if (streaming && state.drawCircles) {
+            drawStream(state);
+        }
+        else if (morphable && morph.isMorphing(now)) {
+            drawMorph(now);
+        }
+        else {
+            drawCurve();
+        }
+        glFlush();
+    }
     program.disable();
-    glfwSwapBuffers(window);
+    {
+        TRACE_SCOPE("glfwSwapBuffers");
+        glfwSwapBuffers(window);
+    }
+    frameNumber++;
 
-    glfwPollEvents();
+    {
+        TRACE_SCOPE("glfwPollEvents");
+        glfwPollEvents();
+    }
 
     frames++;
     double currenttime = glfwGetTime();
 
     if ((currenttime-time)>1.0) {
         printf("Framerate: %2.0f\r",frames/(currenttime-time));
+
+        // drawing is meant to be allocation-free, only checked in ALLOC_TRACKING builds
+        unsigned long allocations = ALLOC_COUNT("frame display");
+        if (allocations != displayAllocations) {
+            spdlog::warn("Drawing allocated {} times in the last second", allocations - displayAllocations);
+            displayAllocations = allocations;
+        }
         frames = 0;
         time = currenttime;
     }
 }
 
-// draws drawing and inner circle
-void View::drawDrawingAndInnerCircle() {
-    color = glm::vec4(0.431,0.780,0.408,1);
-    float radius = (float) model->getSmallCircRadius();
-    float seedRadius = (float) 5.0;
-    if (showCurve) {
-    float bigRadius = (float) model->getBigCircRadius();
-    
+// posts a command to the simulation; a command dropped while driven would make the run
+// differ from the last, so then this waits for room in a full queue instead
+bool View::postCommand(SimulationCommand::Type type, int amount, double value) {
+    if (simulation->post(type, amount, value)) {
+        return true;
+    }
+    if (!isDriven()) {
+        spdlog::warn("Simulation is behind, command dropped");
+        return false;
+    }
+    spdlog::warn("Simulation is behind, frame {} waits for it", frameNumber);
+    while (!simulation->post(type, amount, value)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
 
-    // radius = 400, circumfrence = 2800, step of 1 = 0.1°
-    float step = 10; 
-
-    // if angle is theta, then length of arc is r
-    // if the arc is step, then angle will be step/r
-    float deltaTheta1 = 1.0f *  step / bigRadius;
-    float deltaTheta2 = - 1.0f * step / radius;
-
-    glm::vec4 cp;
-    glm::mat4 cpMatrix;
-    glm::vec4 sp;
-    glm::mat4 spMatrix;
-
-    // if radius changed, refresh needs to be done and this loop executes until angle is reached again
-    // if radius has not been changed, innerCircAngle = savedInnerCircAngle
-    while (innerCircAngle != savedInnerCircAngle) {
-        cp = glm::vec4(0,0,0,1);
-        cpMatrix = glm::mat4(1.0);
-        sp = glm::vec4(0.0,0,0,1);
-        spMatrix = glm::mat4(1.0);
-
-        // scale seed/drawing circle
-        glm::mat4 s_sp = glm::scale(glm::mat4(1.0f), glm::vec3(seedRadius, seedRadius, seedRadius));
-        sp = s_sp * sp;
-        spMatrix = s_sp * spMatrix;
-
-        // Initial center of inner circle
-        float x = bigRadius - radius;
-        float x_sp = x + (radius/2);
-        glm::mat4 t = glm::translate(glm::mat4(1.0f), glm::vec3(x, 0, 0));
-        glm::mat4 t_sp = glm::translate(glm::mat4(1.0f), glm::vec3(x_sp, 0, 0));
-        cp = t * cp;
-        cpMatrix = t * cpMatrix;
-        sp = t_sp * sp;
-        spMatrix = t_sp * spMatrix;
-
-        // first rotation matrix
-        glm::mat4 r1 = glm::rotate(glm::mat4(1.0f), innerCircAngle, glm::vec3(0.0, 0.0, 1.0));
-        cp = r1 * cp;
-        cpMatrix = r1 * cpMatrix;
-        sp = r1 * sp;
-        spMatrix = r1 * spMatrix;
-    
-        // translate to origin
-        float dx = cp.x; // inner circle current posX
-        float dy = cp.y; // inner circle current posY
-        glm::mat4 t2 = glm::translate(glm::mat4(1.0f), glm::vec3(-dx, -dy, 0));
-        cp = t2 * cp;
-        cpMatrix = t2 * cpMatrix;
-        sp = t2 * sp;
-        spMatrix = t2 * spMatrix;
-        
-        // second rotation matrix
-        glm::mat4 r2 = glm::rotate(glm::mat4(1.0f), innerCircRotAngle, glm::vec3(0.0, 0.0, 1.0));
-        cp = r2 * cp;
-        cpMatrix = r2 * cpMatrix;
-        sp = r2 * sp;
-        spMatrix = r2 * spMatrix;
-
-        // scale
-        glm::mat4 s = glm::scale(glm::mat4(1.0f), glm::vec3(radius, radius, radius));
-        cp = s * cp;
-        cpMatrix = s * cpMatrix;
-
-        // translate back to position
-        glm::mat4 t3 = glm::translate(glm::mat4(1.0f), glm::vec3(dx, dy, 0));
-        cp = t3 * cp;
-        cpMatrix = t3 * cpMatrix;
-        sp = t3 * sp;
-        spMatrix = t3 * spMatrix;
-
-        innerCircAngle = innerCircAngle + deltaTheta1;
-        innerCircRotAngle = innerCircRotAngle + deltaTheta2;
-    }
-
-    savedInnerCircAngle = savedInnerCircAngle + deltaTheta1;
-    savedInnerCircRotAngle = savedInnerCircRotAngle + deltaTheta2;
-
-    innerCircCentre = glm::vec2(cp.x, cp.y);
-    seedCentre = glm::vec2(sp.x, sp.y);
-    
-    // draw seed/drawing circle
-    modelview = glm::mat4(1.0) * spMatrix;
-    getShaderLocations();
-    objects[0]->draw();
+// lets seconds pass in a driven simulation and waits until they have
+void View::advanceDriven(double seconds) {
+    postCommand(SimulationCommand::ADVANCE, 0, seconds);
+    advancesPosted++;
+    // the frame shows the state after this step, however long regenerating the curve takes
+    while (simulation->latest().advances < advancesPosted) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
 
-    // draw inner Circle
-    color = glm::vec4(0.949,0.549,0.156,1);
-    modelview = glm::mat4(1.0) * cpMatrix;
-    getShaderLocations();
-    objects[0]->draw();
+// uploads the curve when the simulation has regenerated it
+void View::updateCurve(const SimulationState& state) {
+    if (state.curveVersion == curveVersion || !state.curve) {
+        return;
     }
-    else {
-        // draw seed/drawing circle
-        modelview = glm::mat4(1.0);
-        modelview = modelview * glm::translate(glm::mat4(1.0f), glm::vec3(seedCentre.x, seedCentre.y, 0))
+    setCurve(state.curve);
+    curveVersion = state.curveVersion;
+}
+
+// draws drawing and inner circle, and the gears rolling on it
+void View::drawDrawingAndInnerCircle(const SimulationState& state) {
+    float seedRadius = (float) 5.0;
+
+    double theta = getPenAngle(state);
+    glm::vec2 centres[MAX_GEARS];
+    float rotations[MAX_GEARS];
+    state.train.getPose(theta, centres, rotations);
+    int last = state.train.getGearCount() - 1;
+
+    // draw seed/drawing circle of every pen, they turn with the last gear
+    color = glm::vec4(0.431,0.780,0.408,1);
+    for (int i=0;i<state.penCount;i++) {
+        glm::vec2 pen = centres[last] + (float) state.penOffsets[i]
+            * glm::vec2(cos(rotations[last]), sin(rotations[last]));
+        modelview = glm::translate(glm::mat4(1.0f), glm::vec3(pen.x, pen.y, 0))
             * glm::scale(glm::mat4(1.0),glm::vec3(seedRadius,seedRadius,seedRadius));
-            
-         getShaderLocations();
+        getShaderLocations();
         objects[0]->draw();
+    }
 
-        // draw inner Circle
-        color = glm::vec4(0.949,0.549,0.156,1);
-        modelview = glm::mat4(1.0);
-        modelview = modelview * glm::translate(glm::mat4(1.0f), glm::vec3(innerCircCentre.x, innerCircCentre.y, 0))
-            * glm::scale(glm::mat4(1.0),glm::vec3(radius,radius,radius));//send modelview matrix to GPU  
-         getShaderLocations();
+    // draw inner Circle and the gears on it
+    color = glm::vec4(0.949,0.549,0.156,1);
+    for (int i=0;i<=last;i++) {
+        float radius = (float) state.train.getGear(i).radius;
+        modelview = glm::translate(glm::mat4(1.0f), glm::vec3(centres[i].x, centres[i].y, 0))
+            * glm::rotate(glm::mat4(1.0f), rotations[i], glm::vec3(0.0, 0.0, 1.0))
+            * glm::scale(glm::mat4(1.0),glm::vec3(radius,radius,radius));
+        getShaderLocations();
         objects[0]->draw();
     }
 }
 
+// render between the last two simulated states, by the time left over in the clock
+// plus the time since the state was published (but never past the newest state)
+double View::getPenAngle(const SimulationState& state) {
+    double alpha = state.alpha;
+    if (!input.isReplaying()) {
+        alpha = glm::min(alpha + (glfwGetTime() - state.time) / SIMULATION_STEP, 1.0);
+    }
+    return state.previousPenAngle + (state.penAngle - state.previousPenAngle) * alpha;
+}
+
 // draws outer circle
-void View::drawOuterCircle() {
+void View::drawOuterCircle(const SimulationState& state) {
     color = glm::vec4(1,0,0,1);
-    float radius3 = 400.0f;
+    float radius3 = (float) state.bigCircRadius;
     modelview = glm::mat4(1.0);
     modelview = modelview *
             glm::scale(glm::mat4(1.0),glm::vec3(radius3,radius3,radius3));//send modelview matrix to GPU  
@@ -293,12 +582,185 @@ void View::drawOuterCircle() {
     objects[0]->draw();
 }
 
-// draws curves
+// draws curves, at the coarsest level of detail that is within
+// lodPixelError pixels of the finest one at the current size of the window
 void View::drawCurve() {
     color = curveColor;
     modelview = glm::mat4(1.0);
     getShaderLocations();
-    objects[1]->draw();
+
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    float unitsPerPixel = 2.0f / (projection[0][0] * max(width, 1));
+    // the pens have the same levels, as they are decimated with the same tolerances
+    int levelsPerPen = curveLevels.size() / penCount;
+    int level = 0;
+    for (int i=1;i<levelsPerPen;i++) {
+        if (curveLevels[i].error <= lodPixelError * unitsPerPixel) {
+            level = i;
+        }
+    }
+
+    float halfSize = VIEW_HALF_SIZE / zoom;
+    glm::vec2 low = viewCentre - glm::vec2(halfSize, halfSize);
+    glm::vec2 high = viewCentre + glm::vec2(halfSize, halfSize);
+
+    // all of the pattern is in view: every copy of the lobe in one call
+    if (lobeCount > 1 && low.x <= -curveRadius && high.x >= curveRadius
+        && low.y <= -curveRadius && high.y >= curveRadius) {
+        instanceAngle = lobeAngle;
+        getShaderLocations();
+        for (int pen=0;pen<penCount;pen++) {
+            const CurveLevel& chosen = curveLevels[pen * levelsPerPen + level];
+            curveObject->drawInstanced(chosen.first, chosen.count, lobeCount);
+        }
+        instanceAngle = 0;
+        return;
+    }
+
+    // otherwise each copy on its own, with only its chunks that are in view
+    for (int i=0;i<lobeCount;i++) {
+        float angle = i * lobeAngle;
+        modelview = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0, 0.0, 1.0));
+        getShaderLocations();
+        for (int pen=0;pen<penCount;pen++) {
+            drawVisibleChunks(curveLevels[pen * levelsPerPen + level], angle, low, high);
+        }
+    }
+}
+
+// draws the trail of the pens up to where they are drawn this frame,
+// starting it again whenever the simulation changes the gears or pens
+// (but not when it only resamples the curve, as on zooming)
+void View::drawStream(const SimulationState& state) {
+    double theta = getPenAngle(state);
+    if (!stream.isFollowing(state.train, state.penOffsets, state.penCount)) {
+        stream.restart(state.train, state.penOffsets, state.penCount, theta);
+    }
+    else {
+        stream.advance(theta);
+    }
+    color = curveColor;
+    modelview = glm::mat4(1.0);
+    getShaderLocations();
+    stream.draw();
+}
+
+// draws the curve part way between two radii
+void View::drawMorph(double now) {
+    color = curveColor;
+    modelview = glm::mat4(1.0);
+    getShaderLocations();
+    morph.draw(shaderLocations, now);
+}
+
+// draws the chunks of a level that are in view when turned by angle,
+// runs of neighbouring chunks (which share their end points) in one call
+void View::drawVisibleChunks(const CurveLevel& level, float angle, glm::vec2 low, glm::vec2 high) {
+    int runFirst = -1;
+    int runEnd = 0;
+    for (int i=level.firstChunk;i<level.firstChunk + level.chunkCount;i++) {
+        const CurveChunk& chunk = curveChunks[i];
+        if (!isChunkVisible(chunk, angle, low, high)) {
+            continue;
+        }
+        if (runFirst >= 0 && chunk.first == runEnd - 1) {
+            runEnd = chunk.first + chunk.count;
+        }
+        else {
+            if (runFirst >= 0) {
+                curveObject->drawRange(runFirst, runEnd - runFirst);
+            }
+            runFirst = chunk.first;
+            runEnd = chunk.first + chunk.count;
+        }
+    }
+    if (runFirst >= 0) {
+        curveObject->drawRange(runFirst, runEnd - runFirst);
+    }
+}
+
+// true if the chunk turned by angle may overlap the view from low to high;
+// a turned box is tested by its bounding circle
+bool View::isChunkVisible(const CurveChunk& chunk, float angle, glm::vec2 low, glm::vec2 high) {
+    if (angle == 0) {
+        return chunk.maximum.x >= low.x && chunk.minimum.x <= high.x
+            && chunk.maximum.y >= low.y && chunk.minimum.y <= high.y;
+    }
+    glm::vec2 centre = (chunk.minimum + chunk.maximum) * 0.5f;
+    float radius = glm::length(chunk.maximum - centre);
+    glm::vec2 turned(cos(angle) * centre.x - sin(angle) * centre.y,
+                     sin(angle) * centre.x + cos(angle) * centre.y);
+    glm::vec2 nearest = glm::clamp(turned, low, high);
+    return glm::length(turned - nearest) <= radius;
+}
+
+// finds curveRadius from the chunks of the finest level of every pen
+void View::updateCurveRadius() {
+    curveRadius = 0;
+    if (curveLevels.empty()) {
+        return;
+    }
+    int levelsPerPen = curveLevels.size() / penCount;
+    for (int pen=0;pen<penCount;pen++) {
+        const CurveLevel& finest = curveLevels[pen * levelsPerPen];
+        for (int i=finest.firstChunk;i<finest.firstChunk + finest.chunkCount;i++) {
+            glm::vec2 corner = glm::max(glm::abs(curveChunks[i].minimum), glm::abs(curveChunks[i].maximum));
+            curveRadius = glm::max(curveRadius, glm::length(corner));
+        }
+    }
+}
+
+// makes the projection for the current pan and zoom
+void View::updateProjection() {
+    double halfSize = VIEW_HALF_SIZE / zoom;
+    projection = glm::ortho(viewCentre.x - halfSize, viewCentre.x + halfSize,
+                            viewCentre.y - halfSize, viewCentre.y + halfSize);
+}
+
+// zooms by factor, keeping the anchor point (in model coordinates) in place
+void View::zoomAt(double factor, glm::vec2 anchor) {
+    double newZoom = glm::clamp(zoom * factor, 1.0 / 4, MAX_ZOOM);
+    viewCentre = anchor + (viewCentre - anchor) * (float) (zoom / newZoom);
+    zoom = newZoom;
+    updateProjection();
+
+    // the curve was sampled for a pixel tolerance at zoom 1, so have it
+    // sampled finer whenever the zoom passes a power of two
+    int octave = glm::clamp((int) floor(log2(zoom)), 0, MAX_TOLERANCE_OCTAVE);
+    if (octave != toleranceOctave && baseCurveTolerance > 0) {
+        if (postCommand(SimulationCommand::SET_CURVE_TOLERANCE, 0, baseCurveTolerance / (1 << octave))) {
+            toleranceOctave = octave;
+        }
+    }
+}
+
+// zooms at the cursor, one ZOOM_STEP per scroll step
+void View::onscroll(GLFWwindow* window, double xoffset, double yoffset)
+{
+    // while replaying, only the recorded scrolls count
+    if (input.isReplaying()) {
+        return;
+    }
+    double x, y;
+    int width, height;
+    glfwGetCursorPos(window, &x, &y);
+    glfwGetWindowSize(window, &width, &height);
+    // recorded as fractions of the window, so a replay zooms alike in a window of another size
+    x = x / max(width, 1);
+    y = y / max(height, 1);
+    input.recordScroll(frameNumber, glfwGetTime(), yoffset, x, y);
+    handleScroll(yoffset, x, y);
+}
+
+// zooms by offset scroll steps at (x, y), fractions of the window from its top left
+void View::handleScroll(double offset, double x, double y)
+{
+    // window coordinates grow downwards, model coordinates upwards
+    double halfSize = VIEW_HALF_SIZE / zoom;
+    glm::vec2 anchor(viewCentre.x + (2 * x - 1) * halfSize,
+                     viewCentre.y - (2 * y - 1) * halfSize);
+    zoomAt(pow(ZOOM_STEP, offset), anchor);
 }
 
 // gets shader locations
@@ -308,58 +770,98 @@ void View::getShaderLocations() {
     glUniformMatrix4fv(shaderLocations.getLocation("projection"), 1, GL_FALSE, glm::value_ptr(projection));
     //send color to GPU
     glUniform4fv(shaderLocations.getLocation("vColor"),1,glm::value_ptr(color));
+    //send rotation between instances to GPU
+    glUniform1f(shaderLocations.getLocation("instanceAngle"),instanceAngle);
 }
 
 void View::onkey(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
-    // check if "I" is pressed
-    if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS) {
-        int currentRadius = model->getSmallCircRadius();
-        // check if "SHIFT" is pressed
-        if (mods == GLFW_MOD_SHIFT) {
-            if (currentRadius + 5 <= 400) {
-                model->changeInnerCircRadius(5);
-            }
+    // while replaying, only the recorded keys count
+    if (input.isReplaying()) {
+        return;
+    }
+    input.record(frameNumber, glfwGetTime(), key, scancode, action, mods);
+    handleKey(key, scancode, action, mods);
+}
+
+// feeds recorded keys and scrolls of the current frame to handleKey and handleScroll
+void View::replayInput() {
+    if (!input.isReplaying()) {
+        return;
+    }
+    InputEvent event;
+    while (input.nextEvent(frameNumber, event)) {
+        if (event.key == InputRecorder::SCROLL) {
+            handleScroll(event.scrollOffset, event.cursorX, event.cursorY);
         }
         else {
-            if (currentRadius - 5 >= 5) {
-                model->changeInnerCircRadius(-5);
-            }
+            handleKey(event.key, event.scancode, event.action, event.mods);
         }
+    }
+    if (frameNumber == input.getSessionFrames()) {
+        double elapsed = glfwGetTime() - replayStart;
+        spdlog::info("Replayed {} frames in {:.3f} s ({:.3f} ms/frame)",
+            frameNumber, elapsed, frameNumber > 0 ? 1000.0 * elapsed / frameNumber : 0.0);
+        glfwSetWindowShouldClose(window, GLFW_TRUE);
+    }
+}
 
-        for (int i=0;i<objects.size();i++) {
-        objects[i]->cleanup();
-        delete objects[i];
-        }
-        objects.clear();
-
-        // reset model and save angles
-        savedInnerCircAngle = innerCircAngle;
-        savedInnerCircRotAngle = innerCircRotAngle;
-        innerCircAngle = 0.0;
-        innerCircRotAngle = 0.0;
+// reacts to live or replayed keys
+void View::handleKey(int key, int scancode, int action, int mods)
+{
+    // check if "I" is pressed, the simulation thread regenerates the curve
+    if (key == GLFW_KEY_I && action != GLFW_RELEASE) {
+        // check if "SHIFT" is pressed
+        int amount = (mods == GLFW_MOD_SHIFT) ? RADIUS_STEP : -RADIUS_STEP;
+        postCommand(SimulationCommand::CHANGE_RADIUS, amount);
+    }
 
-        // regenerate models
-        vector<util::PolygonMesh<VertexAttrib>> meshes = model->getCircleMesh();
-        makeObject(meshes);
-        meshes = model->getCurveMesh();
-        makeObject(meshes);
+    // "D" moves the pens towards the rim of the inner circle, "SHIFT+D" towards its centre
+    if (key == GLFW_KEY_D && action != GLFW_RELEASE) {
+        double step = (mods == GLFW_MOD_SHIFT) ? -PEN_OFFSET_STEP : PEN_OFFSET_STEP;
+        postCommand(SimulationCommand::CHANGE_PEN_OFFSET, 0, step);
+    }
 
+    // "E" rolls the inner circle around the outside of the outer one, or back inside
+    if (key == GLFW_KEY_E && action == GLFW_PRESS) {
+        postCommand(SimulationCommand::TOGGLE_OUTSIDE);
     }
 
     // check if "C" is pressed
-    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS) {
-        if (showCurve) {
-            //curveColor = glm::vec4(0,0,0,1);
-            showCurve = false;
-            printf("showCurve turned off\n");
-        }
-        else {
-            //curveColor = glm::vec4(0.431,0.780,0.408,1);
-            showCurve = true;
-            printf("showCurve turned on\n");
-        }
+    if (key == GLFW_KEY_C && action != GLFW_RELEASE) {
+        postCommand(SimulationCommand::TOGGLE_PEN);
     }
+
+    // "+" and "-" zoom at the centre of the window, "0" shows everything again
+    if (action == GLFW_RELEASE) {
+        return;
+    }
+    if (key == GLFW_KEY_EQUAL || key == GLFW_KEY_KP_ADD) {
+        zoomAt(ZOOM_STEP, viewCentre);
+    }
+    if (key == GLFW_KEY_MINUS || key == GLFW_KEY_KP_SUBTRACT) {
+        zoomAt(1 / ZOOM_STEP, viewCentre);
+    }
+    if (key == GLFW_KEY_0) {
+        viewCentre = glm::vec2(0,0);
+        zoomAt(1 / zoom, viewCentre);
+    }
+
+    // arrow keys pan by a fraction of the view
+    float panStep = PAN_STEP * 2 * VIEW_HALF_SIZE / zoom;
+    if (key == GLFW_KEY_LEFT) {
+        viewCentre.x = viewCentre.x - panStep;
+    }
+    if (key == GLFW_KEY_RIGHT) {
+        viewCentre.x = viewCentre.x + panStep;
+    }
+    if (key == GLFW_KEY_DOWN) {
+        viewCentre.y = viewCentre.y - panStep;
+    }
+    if (key == GLFW_KEY_UP) {
+        viewCentre.y = viewCentre.y + panStep;
+    }
+    updateProjection();
 }
 
 // called from Controller.cpp
@@ -370,6 +872,28 @@ bool View::shouldWindowClose() {
 // called from Controller.cpp
 void View::closeWindow(){
     
+    input.finish(frameNumber);
+    if (gpuCurveCacheEnabled) {
+        spdlog::info("GPU curve cache: {} hits, {} misses, {} evictions, {} curves in {:.1f} of {:.1f} MiB",
+            gpuCurveCache.getHits(), gpuCurveCache.getMisses(), gpuCurveCache.getEvictions(),
+            gpuCurveCache.getEntryCount(), gpuCurveCache.getBytes() / 1048576.0,
+            gpuCurveCache.getCapacity() / 1048576.0);
+    }
+    // free the curve buffers while there still is a context
+    curveObject.reset();
+    gpuCurveCache.clear();
+    stream.clear();
+    morph.clear();
     glfwDestroyWindow(window);
     glfwTerminate();
-};
\ No newline at end of file
+};
+
+// called from Controller.cpp
+bool View::isReplaying() {
+    return input.isReplaying();
+}
+
+// called from Controller.cpp
+bool View::isDriven() {
+    return input.isReplaying() || timeline.isPlanned();
+}
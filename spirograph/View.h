@@ -6,49 +6,102 @@
 #include <ShaderProgram.h>
 #include "Model.h"
 #include <ObjectInstance.h>
+#include "InputRecorder.h"
+#include "Simulation.h"
+#include "CurveStream.h"
+#include "CurveMorph.h"
+#include "Timeline.h"
 
 // Header for View of Spirograph program.
 
+#define REPLAY_FRAME_TIME (1.0 / 60.0) // seconds per frame while replaying input
+#define CURVE_LEVELS 4 // levels of detail of the curve, see Model::setCurveLevelCount
+#define VIEW_HALF_SIZE 800.0 // model units from the centre to the edge of the view at zoom 1
+#define MAX_ZOOM 1024.0
+#define ZOOM_STEP 1.25 // zoom factor of one key press or scroll step
+#define PAN_STEP 0.1 // fraction of the view moved by one arrow key press
+#define MAX_TOLERANCE_OCTAVE 6 // the curve is resampled finer up to 2^6 times zoom
+#define GPU_CURVE_CACHE_BYTES (32 << 20) // GPU memory for uploaded curves kept for reuse
+#define STREAM_CAPACITY 65536 // points of the trail of each pen in streaming mode, unless set
+
 class View
 {
 public:
     View();
     ~View();
-    int init(Model* m); // sets up the View for the program
+    int init(Model* m, Simulation* s); // sets up the View for the program
     void display(); // draws the lines based on vertex coordinates, defines circles
     bool shouldWindowClose(); // called from Controller.cpp
     void closeWindow(); // called from Controller.cpp
+    bool isReplaying(); // called from Controller.cpp
+    bool isDriven(); // frames advance the simulation by fixed steps, when replaying or playing a timeline
 private:   
     Model *model;
+    Simulation *simulation; // moves the pen, owns the model once started
     GLFWwindow *window;
     util::ShaderProgram program;
     util::ShaderLocationsVault shaderLocations;
     vector<util::ObjectInstance *> objects;
+    shared_ptr<util::ObjectInstance> curveObject; // the uploaded curve
+    LruCache<CurveKey, shared_ptr<util::ObjectInstance> > gpuCurveCache; // recently uploaded curves
+    bool gpuCurveCacheEnabled;
+    bool streaming; // draws the trail of the pens instead of the generated curve
+    CurveStream stream;
+    CurveMorph morph; // eases the curve between radii
+    Timeline timeline; // played back when planned
     glm::mat4 modelview,projection;
     int frames;
     double time;
+    unsigned long displayAllocations; // allocations while drawing, as of the last framerate printout
+    unsigned long frameNumber; // frames drawn so far
+    unsigned long advancesPosted; // ADVANCE commands posted to a driven simulation
+    InputRecorder input; // records or replays key and scroll events
+    double replayStart; // time the replay started
    
     glm::vec4 motion;
     glm::vec4 color;
     glm::vec4 curveColor; // color for the curves
-    bool showCurve; // to toggle curve drawing
     glm::vec2 window_dimensions;
     double speed;
-    glm::vec2 innerCircCentre;
-    glm::vec2 seedCentre;
-    float innerCircAngle; // angle for translation of inner circle
-    float innerCircRotAngle; // angle of rotation of inner circle
-    float savedInnerCircAngle; // saved InnerCircAngle
-    float savedInnerCircRotAngle; // saved CircRotAngle
+    unsigned long curveVersion; // version of the curve in curveObject
+    vector<CurveLevel> curveLevels; // levels of detail within curveObject, pen by pen
+    int penCount; // line strips in curveObject, each with levels of its own
+    vector<CurveChunk> curveChunks; // chunks of the levels, with bounding boxes
+    int lobeCount; // turned copies of curveObject making up the pattern
+    float lobeAngle; // rotation from one copy to the next
+    float curveRadius; // distance from the centre to the furthest point of the pattern
+    float instanceAngle; // rotation between the instances of the next draw, 0 if not instanced
+    glm::vec2 viewCentre; // model coordinates at the centre of the window
+    double zoom; // 1 shows VIEW_HALF_SIZE units from the centre to each edge
+    double baseCurveTolerance; // curve tolerance at zoom 1, in model units
+    int toleranceOctave; // power of two of the zoom the curve was last sampled for
+    float lodPixelError; // pixels the drawn curve may be off from the finest level
     map<string, string> shaderVarsToVertexAttribs;
     // creates objects to render mesh:
-    void makeObject(vector<util::PolygonMesh<VertexAttrib> > meshes); 
+    void makeObject(const vector<util::PolygonMesh<VertexAttrib> >& meshes); 
+    util::ObjectInstance *makeObject(const util::PolygonMesh<VertexAttrib>& mesh);
+    void setCurve(const shared_ptr<const CurveData>& curve); // draws this curve from now on
+    void updateCurve(const SimulationState& state); // uploads a regenerated curve
+    bool postCommand(SimulationCommand::Type type, int amount = 0, double value = 0); // waits instead of dropping while driven
+    void advanceDriven(double seconds); // lets seconds pass in a driven simulation and waits for them
     void drawInnerCircle(); // draws inner circle
-    void drawDrawingAndInnerCircle(); // draws drawing and inner circle
-    void drawOuterCircle(); // draws outer circle
+    void drawDrawingAndInnerCircle(const SimulationState& state); // draws drawing and inner circle
+    void drawOuterCircle(const SimulationState& state); // draws outer circle
     void drawCurve(); // draws curves
+    void drawStream(const SimulationState& state); // draws the trail of the pens, streaming the new points
+    void drawMorph(double now); // draws the curve part way between two radii
+    double getPenAngle(const SimulationState& state); // pen angle of the frame being drawn
+    void drawVisibleChunks(const CurveLevel& level, float angle, glm::vec2 low, glm::vec2 high);
+    bool isChunkVisible(const CurveChunk& chunk, float angle, glm::vec2 low, glm::vec2 high);
+    void updateCurveRadius(); // finds curveRadius from the chunks of the finest level
+    void updateProjection(); // makes the projection for the current pan and zoom
+    void zoomAt(double factor, glm::vec2 anchor); // zooms keeping the anchor point in place
+    void onscroll(GLFWwindow* window, double xoffset, double yoffset); // zooms at the cursor
+    void handleScroll(double offset, double x, double y); // reacts to live or replayed scrolls
     void getShaderLocations(); // gets shader locations
     void onkey(GLFWwindow* window, int key, int scancode, int action, int mods);
+    void handleKey(int key, int scancode, int action, int mods); // reacts to live or replayed keys
+    void replayInput(); // feeds recorded keys and scrolls of the current frame to handleKey and handleScroll
 };
 
 #endif
\ No newline at end of file
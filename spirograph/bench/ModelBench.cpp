@@ -0,0 +1,526 @@
+#include <glad/glad.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <new>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <sstream>
+#include <fstream>
+#include "Model.h"
+#include "ShapeRoller.h"
+#include "Simulation.h"
+#include "CompensatedSum.h"
+#include <ObjectInstance.h>
+#include <ObjImporter.h>
+#include <ObjExporter.h>
+
+// Micro-benchmarks for the geometry and upload paths of Spirograph program.
+// Build with "make bench" and run ./spirograph_bench [--quick] [--json file].
+// Each case reports time per call and per vertex, its spread over the
+// repetitions and the heap allocations per call, so that two builds can be
+// compared by diffing their JSON output. The accuracy cases report how far
+// a closed curve's last point is from its first, or how far sampled points
+// are from the curve summed directly.
+
+// every heap allocation made by the program goes through here and is counted
+static unsigned long allocations = 0;
+
+#ifdef SPIROGRAPH_TRACK_ALLOCATIONS
+#include "AllocationTracker.h"
+// AllocationTracker already replaces operator new and counts everything
+#define BENCH_ALLOCATIONS() AllocationTracker::totalAllocations()
+#else
+#define BENCH_ALLOCATIONS() allocations
+
+void *operator new(size_t size) {
+    allocations++;
+    void *p = malloc(size > 0 ? size : 1);
+    if (p == NULL) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+#endif
+
+// result of one benchmark case
+struct BenchResult {
+    string name; // function being timed
+    int size; // input size, e.g. vertex count or radius
+    long vertices; // vertices processed per call
+    vector<double> times; // ns per call, one per repetition
+    double allocationsPerCall;
+};
+
+// result of one accuracy case
+struct AccuracyResult {
+    string name;
+    int size; // e.g. number of gears
+    double periods; // turns of theta the curve takes to close
+    double error; // distance between the first and last points, or from the exact curve, in model units
+};
+
+// has access to the private mesh builders of Model
+class ModelBench
+{
+public:
+    static void makeDrawingCurveMesh(Model& model) {
+        model.makeDrawingCurveMesh();
+    }
+    static void dropCurveMesh(Model& model) {
+        model.curveMesh.pop_back();
+    }
+    static vector<VertexAttrib> createVertexData(Model& model, const vector<glm::vec4>& positions) {
+        return model.createVertexData(positions);
+    }
+};
+
+static double minSeconds = 0.25; // minimum timed duration of each case
+static const int MIN_REPETITIONS = 5;
+static const int MAX_REPETITIONS = 2000;
+
+// calls setup (untimed) and body (timed) until enough time has been measured
+static BenchResult runCase(const string& name, int size, long vertices,
+                           function<void()> setup, function<void()> body) {
+    BenchResult result;
+    result.name = name;
+    result.size = size;
+    result.vertices = vertices;
+
+    unsigned long bodyAllocations = 0;
+    double total = 0;
+    while ((result.times.size() < MIN_REPETITIONS || total < minSeconds * 1e9)
+           && result.times.size() < MAX_REPETITIONS) {
+        setup();
+        unsigned long before = BENCH_ALLOCATIONS();
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        body();
+        chrono::steady_clock::time_point end = chrono::steady_clock::now();
+        bodyAllocations += BENCH_ALLOCATIONS() - before;
+        double ns = chrono::duration<double, nano>(end - start).count();
+        result.times.push_back(ns);
+        total += ns;
+    }
+    result.allocationsPerCall = (double) bodyAllocations / result.times.size();
+    return result;
+}
+
+// positions along a circle of radius 400, like a curve of n points
+static vector<glm::vec4> makePositions(int n) {
+    vector<glm::vec4> positions;
+    for (int i = 0; i < n; i++) {
+        float t = 2 * M_PI * i / n;
+        positions.push_back(glm::vec4(400 * cos(t), 400 * sin(t), 0, 1));
+    }
+    return positions;
+}
+
+// line strip mesh through the given positions, as Model builds it
+static util::PolygonMesh<VertexAttrib> makeLineMesh(Model& model, const vector<glm::vec4>& positions) {
+    util::PolygonMesh<VertexAttrib> mesh;
+    mesh.setVertexData(ModelBench::createVertexData(model, positions));
+    vector<unsigned int> indices;
+    for (unsigned int i = 0; i < positions.size(); i++) {
+        indices.push_back(i);
+    }
+    mesh.setPrimitives(indices);
+    mesh.setPrimitiveType(GL_LINE_STRIP);
+    mesh.setPrimitiveSize(2);
+    return mesh;
+}
+
+// triangle fan over the given positions, because ObjImporter only reads polygons
+static util::PolygonMesh<VertexAttrib> makeTriangleMesh(Model& model, const vector<glm::vec4>& positions) {
+    util::PolygonMesh<VertexAttrib> mesh;
+    mesh.setVertexData(ModelBench::createVertexData(model, positions));
+    vector<unsigned int> indices;
+    for (unsigned int i = 2; i < positions.size(); i++) {
+        indices.push_back(0);
+        indices.push_back(i - 1);
+        indices.push_back(i);
+    }
+    mesh.setPrimitives(indices);
+    mesh.setPrimitiveType(GL_TRIANGLES);
+    mesh.setPrimitiveSize(3);
+    return mesh;
+}
+
+static double mean(const vector<double>& v) {
+    double sum = 0;
+    for (unsigned int i = 0; i < v.size(); i++) {
+        sum += v[i];
+    }
+    return sum / v.size();
+}
+
+static double stddev(const vector<double>& v) {
+    double m = mean(v);
+    double sum = 0;
+    for (unsigned int i = 0; i < v.size(); i++) {
+        sum += (v[i] - m) * (v[i] - m);
+    }
+    return v.size() > 1 ? sqrt(sum / (v.size() - 1)) : 0;
+}
+
+static double median(vector<double> v) {
+    sort(v.begin(), v.end());
+    return v[v.size() / 2];
+}
+
+static void printTable(const vector<BenchResult>& results) {
+    printf("%-36s %8s %8s %6s %12s %10s %8s %10s\n",
+        "benchmark", "size", "vertices", "reps", "median ns", "ns/vertex", "cv %", "allocs");
+    for (unsigned int i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        double med = median(r.times);
+        printf("%-36s %8d %8ld %6zu %12.0f %10.2f %8.1f %10.1f\n",
+            r.name.c_str(), r.size, r.vertices, r.times.size(), med, med / r.vertices,
+            100 * stddev(r.times) / mean(r.times), r.allocationsPerCall);
+    }
+}
+
+static void printAccuracy(const vector<AccuracyResult>& accuracy) {
+    printf("\n%-36s %8s %12s %14s\n", "accuracy", "size", "turns", "error");
+    for (unsigned int i = 0; i < accuracy.size(); i++) {
+        const AccuracyResult& a = accuracy[i];
+        printf("%-36s %8d %12.0f %14.3g\n", a.name.c_str(), a.size, a.periods, a.error);
+    }
+}
+
+// The pen of a train sampled over its period as the curve generator did
+// before phases were reduced: every phasor turned step by step in float,
+// without ever being evaluated exactly again.
+static double floatRecurrenceClosure(const GearTrain& train, int count, double penOffset) {
+    float step = (float) (train.getPeriod(1e300) / (count - 1));
+    // the phasors at theta = 0 and the turn of each over one step, from two poses
+    glm::vec2 centres[MAX_GEARS], nextCentres[MAX_GEARS];
+    float rotations[MAX_GEARS], nextRotations[MAX_GEARS];
+    train.getPose(0, centres, rotations);
+    train.getPose(step, nextCentres, nextRotations);
+    int gears = train.getGearCount();
+    glm::vec2 phasors[MAX_GEARS + 1];
+    glm::vec2 factors[MAX_GEARS + 1];
+    for (int i = 0; i < gears; i++) {
+        phasors[i] = i == 0 ? centres[0] : centres[i] - centres[i - 1];
+        glm::vec2 next = i == 0 ? nextCentres[0] : nextCentres[i] - nextCentres[i - 1];
+        float angle = atan2(next.y, next.x) - atan2(phasors[i].y, phasors[i].x);
+        factors[i] = glm::vec2(cos(angle), sin(angle));
+    }
+    phasors[gears] = glm::vec2((float) penOffset, 0);
+    factors[gears] = glm::vec2(cos(nextRotations[gears - 1]), sin(nextRotations[gears - 1]));
+
+    glm::vec2 first, pen;
+    for (int point = 0; point < count; point++) {
+        pen = glm::vec2(0, 0);
+        for (int i = 0; i <= gears; i++) {
+            pen = pen + phasors[i];
+            phasors[i] = glm::vec2(phasors[i].x * factors[i].x - phasors[i].y * factors[i].y,
+                                   phasors[i].x * factors[i].y + phasors[i].y * factors[i].x);
+        }
+        if (point == 0) {
+            first = pen;
+        }
+    }
+    return glm::length(pen - first);
+}
+
+static bool writeJson(const vector<BenchResult>& results, const vector<AccuracyResult>& accuracy,
+                      const char *file) {
+    FILE *out = fopen(file, "w");
+    if (out == NULL) {
+        return false;
+    }
+    fprintf(out, "{\"benchmarks\":[\n");
+    for (unsigned int i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        double med = median(r.times);
+        fprintf(out, "{\"name\":\"%s\",\"size\":%d,\"vertices\":%ld,\"repetitions\":%zu,"
+            "\"mean_ns\":%.1f,\"median_ns\":%.1f,\"min_ns\":%.1f,\"stddev_ns\":%.1f,"
+            "\"ns_per_vertex\":%.3f,\"allocations_per_call\":%.1f}%s\n",
+            r.name.c_str(), r.size, r.vertices, r.times.size(),
+            mean(r.times), med, *min_element(r.times.begin(), r.times.end()), stddev(r.times),
+            med / r.vertices, r.allocationsPerCall, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "],\"accuracy\":[\n");
+    for (unsigned int i = 0; i < accuracy.size(); i++) {
+        const AccuracyResult& a = accuracy[i];
+        fprintf(out, "{\"name\":\"%s\",\"size\":%d,\"turns\":%.0f,\"error\":%.3g}%s\n",
+            a.name.c_str(), a.size, a.periods, a.error, i + 1 < accuracy.size() ? "," : "");
+    }
+    fprintf(out, "]}\n");
+    fclose(out);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const char *jsonFile = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            minSeconds = 0.02;
+        }
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonFile = argv[++i];
+        }
+        else {
+            fprintf(stderr, "usage: %s [--quick] [--json file]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    vector<BenchResult> results;
+    Model model;
+    const char *objFile = "spirograph_bench.obj";
+
+    // the curve always has 20000 points, its shape depends on the inner radius
+    int radii[] = {5, 200, 395};
+    for (int i = 0; i < 3; i++) {
+        model.changeInnerCircRadius(radii[i] - model.getSmallCircRadius());
+        results.push_back(runCase("Model::makeDrawingCurveMesh", radii[i], 20000,
+            [&]() { ModelBench::dropCurveMesh(model); },
+            [&]() { ModelBench::makeDrawingCurveMesh(model); }));
+    }
+
+    // adaptive sampling within 0.25 px at 2 units per pixel, vertices vary with the radius
+    model.setCurveTolerance(0.5);
+    for (int i = 0; i < 3; i++) {
+        model.changeInnerCircRadius(radii[i] - model.getSmallCircRadius());
+        ModelBench::dropCurveMesh(model);
+        ModelBench::makeDrawingCurveMesh(model);
+        long vertices = model.getCurveMesh()[0].getVertexCount();
+        results.push_back(runCase("Model::makeDrawingCurveMesh adaptive", radii[i], vertices,
+            [&]() { ModelBench::dropCurveMesh(model); },
+            [&]() { ModelBench::makeDrawingCurveMesh(model); }));
+    }
+
+    // one lobe of the same, drawn turned getLobeCount() times
+    model.setSymmetryInstancing(true);
+    for (int i = 0; i < 3; i++) {
+        model.changeInnerCircRadius(radii[i] - model.getSmallCircRadius());
+        ModelBench::dropCurveMesh(model);
+        ModelBench::makeDrawingCurveMesh(model);
+        long vertices = model.getCurveMesh()[0].getVertexCount();
+        results.push_back(runCase("Model::makeDrawingCurveMesh one lobe", radii[i], vertices,
+            [&]() { ModelBench::dropCurveMesh(model); },
+            [&]() { ModelBench::makeDrawingCurveMesh(model); }));
+    }
+    model.setSymmetryInstancing(false);
+
+    // a family of four pens in one pass, against four times the one pen above
+    vector<double> fourPens;
+    fourPens.push_back(0.25);
+    fourPens.push_back(0.5);
+    fourPens.push_back(0.75);
+    fourPens.push_back(1.0);
+    model.setPenOffsets(fourPens);
+    for (int i = 0; i < 3; i++) {
+        model.changeInnerCircRadius(radii[i] - model.getSmallCircRadius());
+        ModelBench::dropCurveMesh(model);
+        ModelBench::makeDrawingCurveMesh(model);
+        long vertices = model.getCurveMesh()[0].getVertexCount();
+        results.push_back(runCase("Model::makeDrawingCurveMesh 4 pens", radii[i], vertices,
+            [&]() { ModelBench::dropCurveMesh(model); },
+            [&]() { ModelBench::makeDrawingCurveMesh(model); }));
+    }
+    model.setPenOffsets(vector<double>(1, 0.5));
+    model.setCurveTolerance(0);
+
+    // trains of 2, 4 and 8 gears through the phasor recurrence, GEAR_TRAIN_POINTS points
+    Gear train[] = {{60, false}, {25, true}, {10, false}, {30, true}, {15, false}, {45, true}, {20, false}};
+    int gearCounts[] = {2, 4, 8};
+    for (int i = 0; i < 3; i++) {
+        model.setNestedGears(vector<Gear>(train, train + gearCounts[i] - 1));
+        results.push_back(runCase("Model::makeDrawingCurveMesh gears", gearCounts[i], GEAR_TRAIN_POINTS,
+            [&]() { ModelBench::dropCurveMesh(model); },
+            [&]() { ModelBench::makeDrawingCurveMesh(model); }));
+    }
+    model.setNestedGears(vector<Gear>());
+
+    // Fourier curves fitted to a star, sampled at FOURIER_POINTS by one inverse FFT
+    vector<glm::vec2> star;
+    for (int i = 0; i < 10; i++) {
+        double angle = 2 * M_PI * i / 10;
+        double radius = (i % 2 == 0) ? 250 : 100;
+        star.push_back(glm::vec2(radius * cos(angle), radius * sin(angle)));
+    }
+    int termCounts[] = {256, 2048, 8192};
+    for (int i = 0; i < 3; i++) {
+        FourierCurve fourier = FourierCurve::fit(star, termCounts[i], 400);
+        results.push_back(runCase("FourierCurve::sample", termCounts[i], FOURIER_POINTS,
+            []() {},
+            [&]() {
+                vector<glm::vec4> positions;
+                fourier.sample(FOURIER_POINTS, positions);
+            }));
+    }
+
+    // an elliptic gear rolling in an elliptic ring, SHAPE_POINTS points on one thread and on all
+    Shape ring = Shape::ellipse(400, 300, 4096);
+    Shape gear = Shape::ellipse(100, 70, 4096);
+    ShapeRoller roller(ring, gear, false);
+    vector<double> shapePens(1, 50);
+    int threadCounts[] = {1, max((int) std::thread::hardware_concurrency(), 1)};
+    for (int i = 0; i < 2; i++) {
+        results.push_back(runCase("ShapeRoller::sample threads", threadCounts[i], SHAPE_POINTS,
+            []() {},
+            [&]() {
+                vector<vector<glm::vec4> > pens(1);
+                roller.sample(SHAPE_POINTS, roller.getEnd(), shapePens, pens, threadCounts[i]);
+            }));
+    }
+
+    // respaced evenly by arc length, at the size of a long plotter path
+    for (int i = 0; i < 3; i++) {
+        model.changeInnerCircRadius(radii[i] - model.getSmallCircRadius());
+        model.setArcLengthPoints(100000);
+        results.push_back(runCase("Model::makeDrawingCurveMesh arc length", radii[i], 100000,
+            [&]() { ModelBench::dropCurveMesh(model); },
+            [&]() { ModelBench::makeDrawingCurveMesh(model); }));
+    }
+    model.setArcLengthPoints(0);
+
+    // with three coarser levels of detail appended by decimation
+    model.setCurveLevelCount(4);
+    for (int i = 0; i < 3; i++) {
+        model.changeInnerCircRadius(radii[i] - model.getSmallCircRadius());
+        results.push_back(runCase("Model::makeDrawingCurveMesh 4 levels", radii[i], 20000,
+            [&]() { ModelBench::dropCurveMesh(model); },
+            [&]() { ModelBench::makeDrawingCurveMesh(model); }));
+    }
+    model.setCurveLevelCount(1);
+
+    // coming back to a curve made before, which the curve cache hands out again
+    for (int i = 0; i < 3; i++) {
+        model.changeInnerCircRadius(radii[i] - model.getSmallCircRadius());
+        shared_ptr<const CurveData> curve = model.getCurve();
+        results.push_back(runCase("Model::getCurve cached", radii[i], curve->meshes[0].getVertexCount(),
+            []() {},
+            [&]() { model.getCurve(); }));
+    }
+    model.changeInnerCircRadius(200 - model.getSmallCircRadius());
+
+    int sizes[] = {1000, 10000, 100000};
+    for (int i = 0; i < 3; i++) {
+        int n = sizes[i];
+        vector<glm::vec4> positions = makePositions(n);
+        util::PolygonMesh<VertexAttrib> lineMesh = makeLineMesh(model, positions);
+
+        results.push_back(runCase("Model::createVertexData", n, n,
+            []() {},
+            [&]() { ModelBench::createVertexData(model, positions); }));
+
+        results.push_back(runCase("PolygonMesh::computeBoundingBox", n, n,
+            []() {},
+            [&]() { lineMesh.computeBoundingBox(); }));
+
+        map<string, string> shaderVarsToVertexAttribs;
+        shaderVarsToVertexAttribs["vPosition"] = "position";
+        vector<VertexAttrib> vertexDataList;
+        results.push_back(runCase("ObjectInstance::packVertexData", n, n,
+            [&]() { vertexDataList = lineMesh.getVertexAttributes(); },
+            [&]() {
+                map<string, int> offsets;
+                int sizeOfOneVertex;
+                util::ObjectInstance::packVertexData(vertexDataList, shaderVarsToVertexAttribs,
+                                                     offsets, sizeOfOneVertex);
+            }));
+
+        util::PolygonMesh<VertexAttrib> triangleMesh = makeTriangleMesh(model, positions);
+        results.push_back(runCase("ObjExporter::exportFile", n, n,
+            []() {},
+            [&]() {
+                ofstream out(objFile);
+                util::ObjExporter<VertexAttrib>::exportFile(triangleMesh, out);
+            }));
+
+        results.push_back(runCase("ObjImporter::importFile", n, n,
+            []() {},
+            [&]() {
+                ifstream in(objFile);
+                util::ObjImporter<VertexAttrib>::importFile(in, false);
+            }));
+    }
+    remove(objFile);
+
+    // The pen angle after days of simulation steps, added up as
+    // Simulation::advance does and as a plain double sum; the exact angle is
+    // the step times their number, rounded once
+    long long longRunSteps = minSeconds < 0.25 ? 10000000LL : 100000000LL;
+    double deltaTheta = PEN_SPEED / 400 * SIMULATION_STEP;
+    CompensatedSum compensatedAngle;
+    double plainAngle = 0;
+    for (long long i = 0; i < longRunSteps; i++) {
+        compensatedAngle.add(deltaTheta);
+        plainAngle = plainAngle + deltaTheta;
+    }
+    double exactAngle = longRunSteps * deltaTheta;
+
+    // Closure of trains of 1 to 8 gears over their whole period: the points
+    // as generated (stored in float, so within about 1e-4 at best) and the
+    // phasors turned in float step by step for comparison. Then how far the
+    // pen is from where it should be after the long run of steps above
+    vector<AccuracyResult> accuracy;
+    int closureCounts[] = {1, 2, 4, 8};
+    for (int i = 0; i < 4; i++) {
+        Gear gears[MAX_GEARS];
+        gears[0].radius = 150;
+        gears[0].outside = false;
+        for (int j = 1; j < closureCounts[i]; j++) {
+            gears[j] = train[j - 1];
+        }
+        GearTrain closing(400, gears, closureCounts[i]);
+        double turns = closing.getPeriod(1e300) / (2 * M_PI);
+        double penOffset = 0.5 * gears[closureCounts[i] - 1].radius;
+        vector<vector<glm::vec4> > pens(1);
+        if (closing.samplePeriod(GEAR_TRAIN_POINTS, 1e300, vector<double>(1, penOffset), pens)) {
+            AccuracyResult exact = {"GearTrain::samplePeriod", closureCounts[i], turns,
+                glm::length(glm::vec2(pens[0].back()) - glm::vec2(pens[0].front()))};
+            accuracy.push_back(exact);
+        }
+        AccuracyResult recurrence = {"float recurrence", closureCounts[i], turns,
+            floatRecurrenceClosure(closing, GEAR_TRAIN_POINTS, penOffset)};
+        accuracy.push_back(recurrence);
+        glm::dvec2 exactPen = closing.getPenPosition(exactAngle, penOffset);
+        AccuracyResult compensated = {"pen after steps, compensated sum", closureCounts[i], exactAngle / (2 * M_PI),
+            glm::length(closing.getPenPosition(compensatedAngle.get(), penOffset) - exactPen)};
+        accuracy.push_back(compensated);
+        AccuracyResult plain = {"pen after steps, plain double sum", closureCounts[i], exactAngle / (2 * M_PI),
+            glm::length(closing.getPenPosition(plainAngle, penOffset) - exactPen)};
+        accuracy.push_back(plain);
+    }
+
+    // Fourier curves sampled by one inverse FFT against the series summed
+    // term by term in double at 1024 of the points (all of them would take O(N M)),
+    // so within the rounding of the points to float
+    for (int i = 0; i < 3; i++) {
+        FourierCurve fourier = FourierCurve::fit(star, termCounts[i], 400);
+        vector<glm::vec4> positions;
+        fourier.sample(FOURIER_POINTS, positions);
+        int size = positions.size() - 1;
+        double largest = 0;
+        for (int j = 0; j < size; j += size / 1024) {
+            glm::dvec2 sampled(positions[j].x, positions[j].y);
+            largest = max(largest, glm::length(sampled - fourier.evaluate((double) j / size)));
+        }
+        AccuracyResult sampled = {"FourierCurve::sample vs evaluate", termCounts[i], 1, largest};
+        accuracy.push_back(sampled);
+    }
+
+    printTable(results);
+    printAccuracy(accuracy);
+    if (jsonFile != NULL && !writeJson(results, accuracy, jsonFile)) {
+        fprintf(stderr, "Could not write %s\n", jsonFile);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -4,10 +4,30 @@ layout(location=0) in vec4 vPosition;
 uniform vec4 vColor;
 uniform mat4 projection;
 uniform mat4 modelview;
+uniform float instanceAngle; // rotation from one instance to the next, 0 if not instanced
+uniform bool evaluated; // the curve is worked out from gl_VertexID instead of read from vPosition
+uniform vec2 arms; // distance between the centres of the circles and of the pen from the inner one
+uniform vec4 phaseSteps; // turns of the centre and of the pen per point, and per 1024 points less whole turns
 out vec4 outColor;
 
+// position of point gl_VertexID of a hypotrochoid or epitrochoid; the turns
+// are split at every 1024 points so that a float keeps enough of them
+vec4 evaluate()
+{
+    float high = float(gl_VertexID / 1024);
+    float low = float(gl_VertexID % 1024);
+    vec2 turns = fract(phaseSteps.zw * high) + phaseSteps.xy * low;
+    vec2 angles = 6.28318530718 * fract(turns);
+    return vec4(arms.x * cos(angles.x) + arms.y * cos(angles.y),
+                arms.x * sin(angles.x) + arms.y * sin(angles.y), 0.0, 1.0);
+}
+
 void main()
 {
-    gl_Position = projection * modelview * vPosition;
+    float angle = instanceAngle * gl_InstanceID;
+    mat2 rotation = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+    vec4 source = evaluated ? evaluate() : vPosition;
+    vec4 position = vec4(rotation * source.xy, source.zw);
+    gl_Position = projection * modelview * position;
     outColor = vColor;
 }
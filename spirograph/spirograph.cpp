@@ -3,6 +3,8 @@
 #include "Model.h"
 #include "View.h"
 #include "Controller.h"
+#include "StartupProfiler.h"
+#include "Trace.h"
 #include "spdlog/spdlog.h"
 #include "spdlog/cfg/env.h"
 
@@ -20,8 +22,15 @@ int main()
     spdlog::error("This is at ERROR Leve,");
     spdlog::debug("This is at DEBUG Level,");
 
+    // hot path tracing, only in builds made with TRACING=1
+    TRACE_START();
+
     // BEGIN PROGRAM
+    // spans until the first frame when SPIROGRAPH_STARTUP_TRACE is set
+    StartupProfiler::beginSpan("startup");
+    int modelSpan = StartupProfiler::beginSpan("Model construction");
     Model model;
+    StartupProfiler::endSpan(modelSpan);
     View view;
     Controller controller(&model,&view);
     controller.run();